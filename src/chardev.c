@@ -3,17 +3,67 @@
 *include<linux/uaccess.h>: funciones para copiar datos entre el espacio de usuario y el kernel 
 *include<linux/cdev.h>: manjar char devices 
 *include <linux/slab.h>: manejo de momoria dinámica en el kernel  
-*include"last.h": gestiona el último mensaje ingresado en el buffer 
 *include <linux/spinlock.h>: implementa spinlocks para protección contra accesos concurrentes. Se implementa para manejar el acceso al buffer circular 
 *include"chardev.h": fnciones principales del driver del char device 
+*include <linux/ktime.h>: reloj monotónico de alta resolución (ktime_get_ns) para las marcas de tiempo de las entradas
+*include"chardev_ioctl.h": comandos ioctl compartidos con el programa de userspace
+*include"filter.h": filtros de lectura por descriptor de archivo
+*include <linux/moduleparam.h>: parámetros del módulo (tamaño máximo de entrada)
+*include <linux/module.h>: THIS_MODULE, el módulo queda en uso mientras haya descriptores abiertos
+*include <linux/mm.h>: kvmalloc/kvfree, las entradas grandes se respaldan con páginas de vmalloc
+*include"compress.h": compresión LZ4 opcional de las entradas
+*include <linux/xxhash.h>: hash xxh64 para detectar mensajes repetidos
+*include <linux/shrinker.h>: shrinker para liberar las entradas más antiguas cuando el sistema necesita memoria
+*include <linux/version.h>: la API del shrinker cambió en la versión 6.7 del kernel
+*include <linux/uio.h>: iov_iter para read_iter/write_iter (readv, writev e io_uring)
+*include <linux/poll.h>: poll para avisar cuándo hay entradas por leer
+*include <linux/log2.h>: is_power_of_2 para reconocer las lecturas de una sola clase de prioridad
+*include"ratelimit.h": límite de tasa de escritura por escritor
+*include"persist.h": imagen del buffer en un archivo para conservar las entradas al recargar el módulo
+*include"netlink.h": publicación de las entradas nuevas por generic netlink multicast
+*include"notify.h": avisos de entradas nuevas por eventfd
+*include"keyindex.h": índice de las entradas "clave=valor" por su clave
+*include"overload.h": muestreo de las escrituras cuando los lectores no alcanzan a consumirlas
+*include <linux/capability.h>: guardar la imagen por ioctl requiere CAP_SYS_ADMIN
+*include <linux/seqlock.h>: seqcount para que los lectores recorran el buffer sin tomar el spinlock
+*include <linux/rcupdate.h>: las entradas desalojadas se liberan después de un periodo de gracia (kvfree_rcu)
+*include <linux/llist.h>, <linux/workqueue.h>: los arreglos vaciados por CLEAR se liberan en segundo plano
+*include <linux/cache.h>: alineación a líneas de caché de los grupos de campos del buffer
+*include <linux/topology.h>, <linux/percpu.h>: nodo NUMA de los escritores y lectores y contadores por CPU de operaciones locales y remotas
 */
 #include<linux/fs.h> 
 #include<linux/uaccess.h> 
 #include<linux/cdev.h>
 #include <linux/slab.h> 
-#include"last.h"
 #include <linux/spinlock.h> 
 #include"chardev.h" 
+#include <linux/ktime.h>
+#include"chardev_ioctl.h"
+#include"filter.h"
+#include <linux/moduleparam.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include"compress.h"
+#include <linux/xxhash.h>
+#include <linux/shrinker.h>
+#include <linux/version.h>
+#include <linux/uio.h>
+#include <linux/poll.h>
+#include <linux/log2.h>
+#include"ratelimit.h"
+#include"persist.h"
+#include"netlink.h"
+#include"notify.h"
+#include"keyindex.h"
+#include"overload.h"
+#include <linux/capability.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/llist.h>
+#include <linux/workqueue.h>
+#include <linux/cache.h>
+#include <linux/topology.h>
+#include <linux/percpu.h>
  
 /*Variables globales: 
 *major: variable para almacenar el número asiganado por el kernel para identificar el char device
@@ -22,55 +72,322 @@
 permite crear el archivo en /dev/chardev y vincula el major/minor number con las operaciones del driver. 
 */
 static char command_mode[16] = "";
+
+/*Parámetro max_entry_size: tamaño máximo en bytes de una entrada
+*Las entradas de hasta ENTRY_SIZE usan kmalloc, las más grandes se respaldan con páginas (kvmalloc) hasta LARGE_ENTRY_LIMIT
+*/
+static unsigned int max_entry_size = 64 * 1024;
+module_param(max_entry_size, uint, 0644);
+MODULE_PARM_DESC(max_entry_size, "Tamano maximo en bytes de una entrada (minimo ENTRY_SIZE)");
+
+/*Parámetro dedup: si un mensaje es igual al más reciente no se guarda otra entrada,
+*solo se incrementa el contador de repeticiones y se actualiza el timestamp de la existente
+*/
+static bool dedup;
+module_param(dedup, bool, 0644);
+MODULE_PARM_DESC(dedup, "Agrupar mensajes repetidos consecutivos en una sola entrada");
+
+/*Parámetro max_bytes: presupuesto de memoria en bytes para las entradas del buffer (0 es sin límite)
+*Al escribir se desalojan las entradas más antiguas hasta que la nueva cabe en el presupuesto
+*/
+static unsigned long max_bytes;
+module_param(max_bytes, ulong, 0644);
+MODULE_PARM_DESC(max_bytes, "Presupuesto de memoria en bytes para las entradas (0 sin limite)");
+
+/*Parámetro ring_entries: capacidad del buffer de cada clase de prioridad (baja, normal, crítica)
+*Se lee solo al cargar el módulo, cada valor se ajusta a [1, RING_MAX_ENTRIES]
+*Los arreglos grandes se respaldan con páginas de vmalloc (kvcalloc), así un buffer de millones de entradas no necesita memoria contigua
+*/
+static unsigned int ring_entries[CHARDEV_PRIO_COUNT] = { MAX_ENTRIES, MAX_ENTRIES, MAX_ENTRIES };
+module_param_array(ring_entries, uint, NULL, 0444);
+MODULE_PARM_DESC(ring_entries, "Capacidad de los buffers de prioridad baja, normal y critica");
+
+/*Parámetro numa_local: las entradas se reservan en el nodo NUMA del escritor (kvmalloc_node) y los arreglos
+*de los buffers en el nodo del buffer (home_node), sin la opción el kernel elige el nodo de cada reserva
+*Las estadísticas cuentan las escrituras y lecturas locales y remotas con o sin la opción
+*/
+static bool numa_local;
+module_param(numa_local, bool, 0444);
+MODULE_PARM_DESC(numa_local, "Reservar las entradas en el nodo NUMA del escritor");
+
+/*Parámetro persist_path: archivo donde se guardan las entradas al descargar el módulo (o con CHARDEV_IOC_PERSIST)
+*Si el archivo existe al cargar el módulo, sus entradas se restauran con los mismos números de secuencia y timestamps
+*/
+static char *persist_path;
+module_param(persist_path, charp, 0444);
+MODULE_PARM_DESC(persist_path, "Archivo para guardar y restaurar las entradas al recargar el modulo");
+
 static int major; //Número que el kernel asigna para identificar el chardevice 
 static struct class *char_class = NULL;
 static struct device *char_device = NULL; 
 
-/*Estructura del buffer circular:
-*entries: arreglo de punteros a strings(las entradas del buffer) de tamaño MAX_ENTRIES
-*head: indice de escritura. 
-*count: contador de los mensajes actuales del buffer 
-*lock: spinlock para prevenir el acceso simultáneo al buffer 
+/*Estructura de una entrada del buffer:
+*seq: número de secuencia de la entrada, crece en uno por cada escritura desde que se cargó el módulo
+*timestamp: marca de tiempo en ns (ktime_get_ns) tomada al publicar la entrada en el buffer
+*len: longitud del mensaje sin contar el terminador nulo
+*stored_len: bytes guardados en data sin contar el terminador nulo (menor a len si la entrada está comprimida)
+*prio: clase de prioridad de la entrada (CHARDEV_PRIO_*)
+*flags: ENTRY_COMPRESSED si data contiene el mensaje comprimido con LZ4 (sin terminador nulo)
+*       ENTRY_HASHED si hash es válido (se calcula solo con dedup activo)
+*       ENTRY_KEYED si la entrada está en el índice por clave (parámetro keyed), key_hash es el hash de su clave
+*hash: xxh64 del mensaje original
+*key_hash: hash de la clave del mensaje, para quitar la entrada del índice al desalojarla sin volver a leer el mensaje
+*repeat: veces que el mensaje se repitió después de guardarse
+*weight: escrituras que representa la entrada contando sus repeticiones, cada escritura suma 1 o la tasa del muestreo si se guardó en sobrecarga
+*alloc_size: bytes que ocupa realmente la asignación (redondeada por kmalloc o a páginas por vmalloc)
+*node: nodo NUMA de la memoria de la entrada (el de su primera página si es de vmalloc)
+*next: siguiente entrada en una lista de entradas por liberar, solo se usa después de sacarla del buffer
+*rcu: para liberar la entrada cuando ya no hay lectores optimistas que la estén copiando, comparte espacio con next
+*data: mensaje terminado en nulo, se reserva junto con la estructura en una sola asignación (kvmalloc)
+*/
+#define ENTRY_COMPRESSED 0x1
+#define ENTRY_HASHED 0x2
+#define ENTRY_KEYED 0x4
+
+struct chardev_entry {
+    u64 seq;
+    u64 timestamp;
+    size_t len;
+    size_t stored_len;
+    unsigned int prio;
+    unsigned int flags;
+    unsigned int repeat;
+    unsigned int weight;
+    u64 hash;
+    u64 key_hash;
+    size_t alloc_size;
+    int node;
+    union {
+        struct chardev_entry *next;
+        struct rcu_head rcu;
+    };
+    char data[];
+};
+
+/*Estado por descriptor de archivo, se guarda en filep->private_data:
+*filter: filtro que se aplica a las entradas antes de copiarlas al usuario
+*partial_seq, partial: entrada leída parcialmente (cuando el buffer del usuario no alcanzó) y bytes ya copiados de ella
+*write_prio: clase de las escrituras que no empiezan con un byte de prioridad
+*read_mask: clases que se leen con este descriptor (CHARDEV_PRIO_MASK)
+*format: formato de lectura (CHARDEV_FORMAT_TEXT o CHARDEV_FORMAT_BINARY)
+*notify: eventfd registrado con CHARDEV_IOC_SET_NOTIFY, NULL si no hay
+*reader: posición del descriptor para el muestreo en sobrecarga (overload_consumed)
+*/
+struct chardev_file {
+    struct chardev_filter filter;
+    u64 partial_seq;
+    size_t partial;
+    unsigned int write_prio;
+    unsigned int read_mask;
+    unsigned int format;
+    struct notify_reg *notify;
+    struct overload_reader reader;
+};
+
+/*Metadatos de una posición del buffer, en un arreglo denso paralelo a entries:
+*Las búsquedas binarias por número de secuencia o por tiempo leen solo este arreglo (4 posiciones por línea de caché)
+*sin seguir el puntero de cada entrada. Se escriben en ring_push y repeat_newest
+*seq, timestamp: copia de los campos de la entrada en esa posición
+*/
+struct ring_slot {
+    u64 seq;
+    u64 timestamp;
+};
+
+/*Buffer circular de una clase de prioridad, los campos se agrupan en líneas de caché según quién los escribe:
+*Grupo de los lectores (solo cambia con CLEAR):
+*entries: arreglo de punteros de tamaño size (parámetro ring_entries), las entradas quedan ordenadas por número de secuencia desde tail.
+*CLEAR lo reemplaza por un arreglo vacío, los lectores optimistas lo leen con READ_ONCE
+*slots: metadatos de cada posición (struct ring_slot), CLEAR lo conserva porque sus valores fuera de [tail, tail + count) no se leen
+*size: capacidad del buffer
+*Posición de las entradas (la escriben los escritores y la leen los lectores en cada lectura):
+*tail: índice de la entrada más antigua
+*count: entradas actuales de la clase
+*Grupo de los escritores (los lectores no lo leen, así un escritor no invalida la línea de los índices que leen):
+*head: indice de escritura
+*bytes: memoria que ocupan las entradas de la clase
+*evicted: entradas desalojadas de la clase (buffer lleno, presupuesto de bytes o shrinker)
+*/
+struct chardev_ring {
+    struct chardev_entry **entries;
+    struct ring_slot *slots;
+    unsigned int size;
+
+    unsigned int tail ____cacheline_aligned_in_smp;
+    unsigned int count;
+
+    unsigned int head ____cacheline_aligned_in_smp;
+    u64 bytes;
+    u64 evicted;
+} ____cacheline_aligned_in_smp;
+
+/*Estructura del buffer, cada grupo de campos empieza en su propia línea de caché:
+*rings: un buffer circular por clase de prioridad, así una ráfaga de mensajes de baja prioridad no desaloja a los críticos
+*Estado que leen los lectores en cada lectura optimista:
+*seq: seqcount de los cambios al buffer (head, tail, entradas, next_seq, repeticiones), los escritores lo incrementan con lock tomado
+*y los lectores copian sin el spinlock y repiten la copia si un escritor cambió el buffer mientras tanto
+*next_seq: número de secuencia que recibirá la próxima entrada, es común a todas las clases para poder mezclarlas en orden de escritura
+*Contabilidad, la escriben los escritores y solo la leen las estadísticas y el presupuesto de bytes:
+*count: contador de los mensajes actuales de todas las clases
+*raw_bytes, stored_bytes: bytes originales y bytes guardados de las entradas actuales, su cociente es la tasa de compresión
+*compressed: número de entradas actuales guardadas comprimidas
+*repeated: escrituras que se agruparon con la entrada más reciente en lugar de guardarse (dedup)
+*entry_bytes: memoria que ocupan las entradas actuales, es la que se compara con max_bytes
+*budget_evicted, shrinker_freed: entradas desalojadas por el presupuesto de bytes y por el shrinker
+*lock: spinlock para prevenir el acceso simultáneo al buffer entre escritores, en su propia línea para que
+*los escritores que esperan el spinlock no invaliden las líneas que leen los lectores
 */
 static struct {
 
-    char *entries[MAX_ENTRIES]; 
-    int head; 
-    int tail; 
-    int count; 
-    spinlock_t lock; 
+    struct chardev_ring rings[CHARDEV_PRIO_COUNT];
+
+    seqcount_spinlock_t seq ____cacheline_aligned_in_smp;
+    u64 next_seq;
+
+    int count ____cacheline_aligned_in_smp;
+    u64 raw_bytes;
+    u64 stored_bytes;
+    u64 compressed;
+    u64 repeated;
+    u64 entry_bytes;
+    u64 budget_evicted;
+    u64 shrinker_freed;
+
+    spinlock_t lock ____cacheline_aligned_in_smp;
 
 } circ_buffer; 
 
+/*Arreglo de una clase que se vació con CLEAR, sus entradas se liberan en segundo plano (reclaim_work):
+*node: nodo de la lista graveyard
+*entries, size, tail, count: arreglo anterior de la clase y posición de sus entradas
+*/
+struct ring_graveyard {
+    struct llist_node node;
+    struct chardev_entry **entries;
+    unsigned int size;
+    unsigned int tail;
+    unsigned int count;
+};
+
+/*graveyard: arreglos pendientes de liberar, reclaim_work los libera después de un periodo de gracia de RCU*/
+static LLIST_HEAD(graveyard);
+static void reclaim_entries(struct work_struct *work);
+static DECLARE_WORK(reclaim_work, reclaim_entries);
+
+/*Operaciones locales y remotas de cada CPU, se suman en get_stats:
+*local_writes, remote_writes: escrituras publicadas desde un CPU del nodo del buffer (home_node) o de otro nodo
+*local_reads, remote_reads: entradas copiadas a un lector del mismo nodo que la entrada o de otro nodo
+*/
+struct numa_ops {
+    u64 local_writes;
+    u64 remote_writes;
+    u64 local_reads;
+    u64 remote_reads;
+};
+static DEFINE_PER_CPU(struct numa_ops, numa_ops);
+
+/*home_node: nodo NUMA del CPU que cargó el módulo, ahí se reservan los arreglos de los buffers con numa_local*/
+static int home_node = NUMA_NO_NODE;
+
+static struct chardev_entry *detach_entries(void);
+static void free_entries(struct chardev_entry *list);
+static int shrinker_start(void);
+static void shrinker_stop(void);
+static void release_aux(void);
+static void free_buffers(void);
+static int rings_init(void);
+static void rings_free(void);
+static void restore_chardev(void);
+static int save_chardev(void);
+static long persist_now(void);
+
+/*open_files: descriptores abiertos, para contabilizar la memoria del estado por descriptor*/
+static atomic_t open_files = ATOMIC_INIT(0);
+
+/*read_wait: cola de espera de poll, se despierta cada vez que se publica una entrada*/
+static DECLARE_WAIT_QUEUE_HEAD(read_wait);
+
 /*Estructura de operaciones del device
+*owner: el módulo no se puede descargar mientras haya descriptores abiertos, que tienen temporizadores, eventfd y trabajos pendientes
 *open: función llamada cuando se abre el dispositivo
 *release: función llamada cuando se cierra el dispositivo 
-*read: función llamda cuando se lee el dispositivo
-*write: función llamada cuando se escribe al dispositivo 
+*llseek: función llamada para mover la posición de lectura, la posición es el número de secuencia de una entrada
+*read_iter: función llamda cuando se lee el dispositivo (read, readv, io_uring)
+*write_iter: función llamada cuando se escribe al dispositivo (write, writev, io_uring)
+*poll: función llamada para saber si hay entradas por leer
+*fop_flags: FOP_NOWAIT indica que read_iter/write_iter aceptan IOCB_NOWAIT, en kernels anteriores se usa FMODE_NOWAIT en open
+*unlocked_ioctl: función llamada para los comandos de control (consultas por rango de tiempo o de índices, filtros, estadísticas)
 */
 static struct file_operations fops = {
+    .owner = THIS_MODULE,
 	.open = dev_open, 
 	.release = dev_release, 
-    .read = dev_read, 
-    .write = dev_write
+    .llseek = dev_llseek,
+    .read_iter = dev_read_iter, 
+    .write_iter = dev_write_iter,
+    .poll = dev_poll,
+    .unlocked_ioctl = dev_ioctl,
+#ifdef FOP_NOWAIT
+    .fop_flags = FOP_NOWAIT,
+#endif
 };
 
 //Función para inicializar el char device
 int init_chardev(void) {
 
-    int i; 
+    int ret; 
+    unsigned int capacity;
 
     /*Inicializa el spinlock para proteger el buffer*/
     spin_lock_init(&circ_buffer.lock);
-    circ_buffer.head = 0; 
-    circ_buffer.tail = 0; 
+    seqcount_spinlock_init(&circ_buffer.seq, &circ_buffer.lock);
     circ_buffer.count = 0; 
+    circ_buffer.next_seq = 0;
+    circ_buffer.raw_bytes = 0;
+    circ_buffer.stored_bytes = 0;
+    circ_buffer.compressed = 0;
+    circ_buffer.repeated = 0;
+    circ_buffer.entry_bytes = 0;
+    circ_buffer.budget_evicted = 0;
+    circ_buffer.shrinker_freed = 0;
 
-    /*Bucle para limpiar todas las entradas del buffer marcando cada posición como vacía con NULL*/
-    for (i = 0; i < MAX_ENTRIES; i++) { 
-        circ_buffer.entries[i] = NULL; 
+    /*Recursos del buffer, si alguno falla se liberan los que ya se reservaron:
+    *rings_init: buffers circulares de las clases de prioridad, todas las posiciones quedan vacías (NULL)
+    *keyindex_init: tabla del índice por clave si se cargó el módulo con keyed=1, con una cubeta por posición de los buffers.
+    *La capacidad total también es el atraso de los lectores a partir del cual se muestrean las escrituras (overload)
+    *compress_init: buffers de compresión si se cargó el módulo con compress=1
+    *ratelimit_init: cubetas por CPU del límite de tasa
+    *netlink_init: familia de generic netlink donde se publican las entradas nuevas
+    *shrinker_start: registra el shrinker para que el kernel pueda recuperar memoria del buffer
+    */
+    ret = rings_init();
+    if (!ret) {
+        capacity = circ_buffer.rings[CHARDEV_PRIO_LOW].size + circ_buffer.rings[CHARDEV_PRIO_NORMAL].size +
+                   circ_buffer.rings[CHARDEV_PRIO_CRITICAL].size;
+        overload_init(capacity);
+        ret = keyindex_init(capacity);
+    }
+    if (!ret) {
+        ret = compress_init();
+    }
+    if (!ret) {
+        ret = ratelimit_init();
+    }
+    if (!ret) {
+        ret = netlink_init();
+    }
+    if (!ret) {
+        ret = shrinker_start();
+    }
+    if (ret) {
+        netlink_exit();
+        free_buffers();
+        return ret;
     }
 
+    /*Restaura las entradas guardadas antes de crear el dispositivo, todavía no hay lectores ni escritores*/
+    restore_chardev();
+
     /*Registra el dispositivo de caracteres en el kernel:
     *0: solicita asignación dinámica del major number
     *Retorna valores negativos en caso de error
@@ -82,6 +399,7 @@ int init_chardev(void) {
     major = register_chrdev(0, DEVICE_NAME, &fops); 
     if (major < 0) { 
         printk(KERN_ALERT "Modulo: Registro del char device fallo con %i\n", major);
+        release_aux();
         return major;
     }
     printk(KERN_INFO "Modulo: Registro de char device exitoso con numero mayor %i\n", major);
@@ -100,6 +418,7 @@ int init_chardev(void) {
         * */
         if (IS_ERR(char_class)) { 
         unregister_chrdev(major, DEVICE_NAME); 
+        release_aux();
         return PTR_ERR(char_class);
     }
  
@@ -120,6 +439,7 @@ int init_chardev(void) {
     if (IS_ERR(char_device)) {  
         class_destroy(char_class); 
         unregister_chrdev(major, DEVICE_NAME);
+        release_aux();
         return PTR_ERR(char_device); 
     }
     printk(KERN_INFO "Modulo: Char device creado en /dev/%s\n", DEVICE_NAME);
@@ -134,297 +454,2167 @@ void cleanup_chardev(void) {
     *Guarda el estado previo de interrupciones en "flags"
     **/
     unsigned long flags;
-    spin_lock_irqsave(&circ_buffer.lock, flags);
+    struct chardev_entry *detached;
 
-    /*Liberar memoria*/
-    for (int i = 0; i < MAX_ENTRIES; i++) {
-        kfree(circ_buffer.entries[i]);
-        circ_buffer.entries[i] = NULL;
-    }
+    /*Guarda las entradas en persist_path para restaurarlas en la próxima carga*/
+    save_chardev();
+
+    /*El shrinker se quita primero para que no trabaje sobre el buffer mientras se libera, y el lote de netlink pendiente se envía*/
+    shrinker_stop();
+    netlink_exit();
+
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    detached = detach_entries();
 
     /*Libera el spinlock y restaura el estado de interrupciones*/ 
     spin_unlock_irqrestore(&circ_buffer.lock, flags);
 
+    /*Liberar memoria, incluidos los arreglos que CLEAR dejó pendientes*/
+    free_entries(detached);
+    flush_work(&reclaim_work);
+
     device_destroy(char_class, MKDEV(major, 0));
 
     class_destroy(char_class);
 
     unregister_chrdev(major, DEVICE_NAME);
 
+    free_buffers();
+
     printk(KERN_INFO "Modulo: Modulo desmontado correctamente.\n");
     printk(KERN_INFO "Modulo: Chardev con numero mayor %i eliminado correctamente", major);
 }
 
-//Funcion de lectura del dispositivo 
-ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset) {
+//Arreglo vacío de n elementos de size bytes para un buffer, con numa_local se reserva en home_node
+static void *ring_array(unsigned int n, size_t size) {
+    return kvzalloc_node(array_size(n, size), GFP_KERNEL, numa_local ? home_node : NUMA_NO_NODE);
+}
 
-    /*flags: variable para guardar el estado de las interrupciones  
-    *output_buffer: variable para guardar el estado de las interrupciones, se inicializa vacío 
-    *output_size: tamaño total necesario para todos los mensajes 
-    *i, pos: variables de iteración  y posición
-    *ret: variable de retorno para los bytes leídos o error 
-    */
-    unsigned long flags;
-    char *output_buffer = NULL; 
-    size_t output_size = 0;
-    int i, pos;
-    ssize_t ret = 0; 
+/*Reserva los arreglos de los buffers circulares con la capacidad de ring_entries*/
+static int rings_init(void) {
+    int p;
 
-    /*Protección de buffer circular: 
-    *spin_lock_irqsave: bloquea el acceso al buffer y deshabilita interrupciones 
-    *Se almacena el estados de interrupciones en flags para restaurarlo después
-    */
-    spin_lock_irqsave(&circ_buffer.lock, flags); //Bloquea el acceso al buffer para que no se use mientras se está leyendo del dispositivo y guarda el estado de las interrupciones en flags para restaurarlo despues
-    
-    /*Modo de operación "last": 
-    *Se activa cuando command_mode contiene "last"
-    *Solo devuelve el mensaje más reciente en el buffer
-    *Requiere que haya al menos un mensaje (circ_buffer.count > 0)*/
-    if (strcmp(command_mode, "last") == 0 && circ_buffer.count > 0){
-
-         /*Cálculo de la posición del último mensaje:
-         * circ_buffer.head apunta a la próxima posición disponible (head-1 es la última escrita)
-         * MAX_ENTRIES asegura el comportamiento circular del buffer
-         */
-        int last_position = (circ_buffer.head -1 + MAX_ENTRIES) % MAX_ENTRIES;
-
-        /*Condicional para verificar que la posición contiene un mensaje válido:
-        *Asigna memoria en el espacio kernel con kmalloc, GFP_KERNEL le da prioridad normal de asignación y se le suma 1 para el salto de línea
-        */
-        if (circ_buffer.entries[last_position]){
-            output_size = strlen(circ_buffer.entries[last_position]) + 1; //+1 para \0
-            output_buffer = kmalloc(output_size + 1, GFP_KERNEL);
-
-            /*Verificación de asignación de memoria:
-            *Si kmalloc falla al asignar memoria se libera el buffer con spin_unlock_irqrestore
-            **/
-            if (!output_buffer){
-                spin_unlock_irqrestore(&circ_buffer.lock, flags);
-                return -ENOMEM;
-            }
+    home_node = numa_node_id();
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        struct chardev_ring *ring = &circ_buffer.rings[p];
 
-            /*Construcción del mensaje de salida:
-             *snprintf es seguro contra desbordamientos de buffer
-             *output_size+1 como límite máximo garantiza no sobrepasar el buffer
-             */
-            snprintf(output_buffer, output_size + 1, "%s\n", circ_buffer.entries[last_position]);
+        ring->size = clamp_t(unsigned int, ring_entries[p], 1, RING_MAX_ENTRIES);
+        ring->entries = ring_array(ring->size, sizeof(*ring->entries));
+        ring->slots = ring_array(ring->size, sizeof(*ring->slots));
+        if (!ring->entries || !ring->slots) {
+            rings_free();
+            return -ENOMEM;
         }
+        ring->head = 0;
+        ring->tail = 0;
+        ring->count = 0;
+        ring->bytes = 0;
+        ring->evicted = 0;
     }
-    /*Modo normal. Concatena todas las entradas del buffer para mostrarlas */
-    else {
-        /*Bucle para calcular el tamaño total requerido para almacenar las entradas: 
-        *Itera sobre todas las entradas válidas(0 a circ_buffer.count-1)
-        *Para cada entrada, se suma +1 para el salto de línea
-        *"pos" cálcula la posición actual
-        *Con el condicional si existe un mensaje en esa posición sumamos su longitud y +1 por el salto de línea 
-        */
-       for (i = 0; i < circ_buffer.count; i++) { 
-            pos = (circ_buffer.tail + i) % MAX_ENTRIES; 
-            if (circ_buffer.entries[pos]) {
-                output_size += strlen(circ_buffer.entries[pos]) + 1; 
-            }
+    return 0;
+}
+
+//Libera los arreglos de los buffers circulares, las entradas ya deben estar liberadas
+static void rings_free(void) {
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        kvfree(circ_buffer.rings[p].entries);
+        kvfree(circ_buffer.rings[p].slots);
+        circ_buffer.rings[p].entries = NULL;
+        circ_buffer.rings[p].slots = NULL;
+    }
+}
+
+/*Acceso a las entradas, deben llamarse con circ_buffer.lock tomado o dentro de una lectura optimista (read_stable):
+*En una lectura optimista un escritor puede estar cambiando el buffer, así que una posición puede estar vacía (NULL);
+*el resultado se descarta y la lectura se repite, pero las funciones no deben seguir un puntero nulo
+*ring_at: entrada en el índice lógico index de un buffer, 0 es la más antigua
+*slot_seq, slot_time: número de secuencia y timestamp de la entrada en el índice lógico index, sin leer la entrada
+*ring_find_seq: índice de la primera entrada del buffer con número de secuencia mayor o igual a seq, count si no hay.
+*Si las secuencias de la clase son contiguas (una sola clase en uso) el índice se calcula directo, si no se usa búsqueda binaria
+*next_entry: entrada con el menor número de secuencia mayor o igual a seq entre las clases de mask, NULL si no hay.
+*Si slot no es NULL guarda en él el slot de la entrada, que sigue con su número de secuencia mientras la entrada no se desaloje
+*find_entry, prev_in_ring: next_entry y la entrada de una clase con el mayor número de secuencia menor a seq, buscadas dentro de una
+*sección de lectura del seqcount que se repite si un escritor cambió el buffer. Se usan sin el spinlock, con la lectura de RCU tomada
+*oldest_seq: número de secuencia de la entrada más antigua de las clases de mask (next_seq si no hay entradas)
+*count_entries: entradas actuales de las clases de mask
+*count_before: entradas de las clases de mask con número de secuencia menor a seq
+*seq_at_index: número de secuencia de la entrada en la posición index (0 es la más antigua) entre las clases de mask, next_seq si no existe
+*oldest_seq, count_before y seq_at_index solo leen los arreglos de slots, se pueden usar en una lectura optimista
+*/
+static struct chardev_entry *ring_at(const struct chardev_ring *ring, unsigned int index) {
+    return READ_ONCE(READ_ONCE(ring->entries)[(READ_ONCE(ring->tail) + index) % ring->size]);
+}
+
+static const struct ring_slot *slot_at(const struct chardev_ring *ring, unsigned int index) {
+    return &READ_ONCE(ring->slots)[(READ_ONCE(ring->tail) + index) % ring->size];
+}
+
+static u64 slot_seq(const struct chardev_ring *ring, unsigned int index) {
+    return READ_ONCE(slot_at(ring, index)->seq);
+}
+
+static u64 slot_time(const struct chardev_ring *ring, unsigned int index) {
+    return READ_ONCE(slot_at(ring, index)->timestamp);
+}
+
+static unsigned int ring_find_seq(const struct chardev_ring *ring, u64 seq) {
+    unsigned int lo = 0, hi = READ_ONCE(ring->count);
+    u64 oldest = hi > 0 ? slot_seq(ring, 0) : 0;
+
+    if (hi > 0 && seq >= oldest && seq - oldest < hi && slot_seq(ring, seq - oldest) == seq) {
+        return seq - oldest;
+    }
+
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+
+        if (slot_seq(ring, mid) < seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
+    }
+    return lo;
+}
 
-        /*Se asigna el buffer de salida con +1 para el cáracter nulo final y GFP_KERNEL para asignación normal de memoria
-        *Si no hay entradas en el buffer se desbloquea y se restaura el estado de las interrupciones
-        */
-       if (output_size > 0) { 
-            output_buffer = kmalloc(output_size + 1, GFP_KERNEL);//Si el buffer está vacío se desbloquea 
-            if (!output_buffer) {
-                spin_unlock_irqrestore(&circ_buffer.lock, flags);
-                return -ENOMEM;
-                }
-
-                /*Se inicializa el buffer como string vacío*/
-                output_buffer[0] = '\0'; 
-
-                /*Construcción del buffer de salida concatenando todas las entradas:
-                *El bucle itera sobre las entradas válidas
-                *"pos" cálcula la posición con % MAX_ENTRIES para aegurar un recorrido circular. Empieza desde el indice más antiguo con circ_byffer.tail
-                */
-                for (i = 0; i < circ_buffer.count; i++) {
-                    pos = (circ_buffer.tail + i) % MAX_ENTRIES;
-                    if (circ_buffer.entries[pos]){
-                        strcat(output_buffer, circ_buffer.entries[pos]);
-                    }
-                }
-            }   
-        }
-        /*Libera el buffer y restaura el estado de las interrupciones con flags después de terminar la concatenación*/
-        spin_unlock_irqrestore(&circ_buffer.lock, flags); 
-        
-        /*Caso en que no hayan entradas para devolver*/
-        if (!output_buffer) {
-            return 0; 
-        }
-
-        /*Cálculo de bytes a copiar:
-        *min() selecciona el menor entre:
-        *   len: Lo que el usuario solicitó
-        *   output_size - *offset: Lo que queda disponible por leer
-        */
-        size_t to_copy = min(len, output_size - *offset); 
-        if (to_copy <= 0) {
-            kfree(output_buffer);
-            return 0;
-        }
-        
-        /*Copiar al espacio usuario
-        *EFAULT indica error al copiar, dirección invalida
-        */
-        if (copy_to_user(buffer, output_buffer + *offset, to_copy) != 0) {
-            kfree(output_buffer);
-            return -EFAULT;
+static struct chardev_entry *next_entry(u64 seq, unsigned int mask, const struct ring_slot **slot) {
+    struct chardev_entry *best = NULL;
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        const struct chardev_ring *ring = &circ_buffer.rings[p];
+        struct chardev_entry *entry;
+        unsigned int index;
+
+        if (!(mask & CHARDEV_PRIO_MASK(p))) {
+            continue;
         }
+        index = ring_find_seq(ring, seq);
+        entry = index < READ_ONCE(ring->count) ? ring_at(ring, index) : NULL;
+        if (entry && (!best || entry->seq < best->seq)) {
+            best = entry;
+            if (slot) {
+                *slot = slot_at(ring, index);
+            }
+        }
+    }
+    return best;
+}
 
-        /*Actualización de estado:
-        *Incrementa offset para la próxima lectura
-        *ret almacena los bytes efectivamente copiados
-        */
-        *offset += to_copy;
-        ret = to_copy;
+static struct chardev_entry *find_entry(u64 seq, unsigned int mask, const struct ring_slot **slot) {
+    struct chardev_entry *entry;
+    unsigned int start;
+
+    do {
+        start = read_seqcount_begin(&circ_buffer.seq);
+        entry = next_entry(seq, mask, slot);
+    } while (read_seqcount_retry(&circ_buffer.seq, start));
+    return entry;
+}
 
-        /*Libera la memoria del buffer temporal*/
-        kfree(output_buffer);
+static struct chardev_entry *prev_in_ring(const struct chardev_ring *ring, u64 seq) {
+    struct chardev_entry *entry;
+    unsigned int start, index;
 
-        /*Reset del modo "last":
-        *Solo se activa una vez por comando "LAST"
-        *strcpy segura porque command_mode tiene tamaño fijo (16 bytes)
-        */
-        if (strcmp(command_mode, "last") == 0) {
-            strcpy(command_mode, "");
+    do {
+        start = read_seqcount_begin(&circ_buffer.seq);
+        index = ring_find_seq(ring, seq);
+        entry = index > 0 ? ring_at(ring, index - 1) : NULL;
+    } while (read_seqcount_retry(&circ_buffer.seq, start));
+    return entry;
+}
+
+static u64 oldest_seq(unsigned int mask) {
+    u64 oldest = READ_ONCE(circ_buffer.next_seq);
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        const struct chardev_ring *ring = &circ_buffer.rings[p];
+
+        if ((mask & CHARDEV_PRIO_MASK(p)) && READ_ONCE(ring->count) > 0) {
+            oldest = min(oldest, slot_seq(ring, 0));
         }
+    }
+    return oldest;
+}
 
-        /*Retorna el número de bytes copiados o error*/
-        return ret;
+static u64 count_entries(unsigned int mask) {
+    u64 count = 0;
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        if (mask & CHARDEV_PRIO_MASK(p)) {
+            count += READ_ONCE(circ_buffer.rings[p].count);
+        }
     }
-     
+    return count;
+}
 
+static u64 count_before(unsigned int mask, u64 seq) {
+    u64 count = 0;
+    int p;
 
-//Funcion de esccritura en el dispositivo 
-ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset) {
-    
-    /*flags: almacena el estado de las interrupciones
-    *kbuf: buffer temporal en el espacio kernel dónde se copian los datos del usuario
-    */
-    unsigned long flags;
-    char *kbuf;
-    
-    /*Condicional para validar la longitud de los datos:*/
-    if (len <= 0 || len > ENTRY_SIZE) {
-        return -EINVAL;
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        if (mask & CHARDEV_PRIO_MASK(p)) {
+            count += ring_find_seq(&circ_buffer.rings[p], seq);
+        }
     }
+    return count;
+}
 
-    /*Manejo de comando CLEAR:*/
-    if (len == 5 && strncmp(buffer, "CLEAR", 5) == 0) {
-        clear_chardev();
-        return len;
+static u64 seq_at_index(unsigned int mask, u64 index) {
+    u64 lo, hi;
+
+    /*Con una sola clase el índice se resuelve directo en su buffer*/
+    if (is_power_of_2(mask)) {
+        const struct chardev_ring *ring = &circ_buffer.rings[__ffs(mask)];
+
+        return index < READ_ONCE(ring->count) ? slot_seq(ring, index) : READ_ONCE(circ_buffer.next_seq);
     }
 
-    /*Manejo del comando LAST:
-    *Verifica que el mensaje es "LAST"
-    *copia la cadena "last" en command_mode para activar el modo(se usa strcpy porque el origen es mas corto que el destino)
-    *Garantiza la terminación nula de "last" para evitar errores si strcpy falla
+    /*Con varias clases se hace una búsqueda binaria sobre los números de secuencia: la entrada buscada es el menor seq
+    *con index + 1 entradas hasta él, y cada paso cuenta con una búsqueda binaria en cada clase, sin recorrer las entradas
     */
-    else if ( len == 4 && strncmp(buffer, "LAST", 4) == 0){
-        strcpy(command_mode, "last");
-        command_mode[sizeof(command_mode)-1] = '\0';
-        return len;
+    if (index >= count_entries(mask)) {
+        return READ_ONCE(circ_buffer.next_seq);
     }
-    
-    /*Asignación de memoria:
-    *Se reservan len+1 para incluir el terminador nulo
-    */
-    kbuf = kmalloc(len + 1, GFP_KERNEL);
-    if (!kbuf) {
-        return -ENOMEM;
+    lo = oldest_seq(mask);
+    hi = READ_ONCE(circ_buffer.next_seq);
+    while (lo < hi) {
+        u64 mid = lo + (hi - lo) / 2;
+
+        if (count_before(mask, mid + 1) <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    
-    /*Copia los datos desde el espacio usuario:*/
-    if (copy_from_user(kbuf, buffer, len) != 0) {
-        kfree(kbuf); 
-        return -EFAULT;
+    return lo;
+}
+
+/*Mensaje original de una entrada:
+*Si está comprimida se descomprime en el buffer del CPU actual, el resultado es válido hasta la siguiente descompresión
+*Retorna NULL si los datos comprimidos están corruptos. Debe llamarse con circ_buffer.lock tomado o dentro de read_stable
+*/
+static const char *entry_data(const struct chardev_entry *entry) {
+    if (!(entry->flags & ENTRY_COMPRESSED)) {
+        return entry->data;
     }
-    
-    kbuf[len] = '\0';
-    
-    /*Protege el buffer de interrupciones y almacena el estado de las interrupciones en flags para restaurarlas
-    */
-    spin_lock_irqsave(&circ_buffer.lock, flags);
-    
-    /*Manejo del buffer lleno (política FIFO):
-    *Si count == MAX_ENTRIES se elimina el mensaje más antiguo
-    *Libera la memoria de la entrada tail(última entrada) y la marca como vacía con NULL
-    *Actualiza tail circularmente, moviendola un espacio
-    */
-    if (circ_buffer.count == MAX_ENTRIES) { 
-        kfree(circ_buffer.entries[circ_buffer.tail]); 
-        circ_buffer.entries[circ_buffer.tail] = NULL; 
-        circ_buffer.tail = (circ_buffer.tail + 1) % MAX_ENTRIES; 
-        circ_buffer.count--;
+    return decompress_get(entry->data, entry->stored_len, entry->len);
+}
+
+/*Contabilidad de bytes de las entradas, se llama con circ_buffer.lock tomado al insertar (sign = 1) o liberar (sign = -1)*/
+static void account_entry(const struct chardev_entry *entry, int sign) {
+    circ_buffer.raw_bytes += sign * (s64)entry->len;
+    circ_buffer.stored_bytes += sign * (s64)entry->stored_len;
+    circ_buffer.entry_bytes += sign * (s64)entry->alloc_size;
+    if (entry->flags & ENTRY_COMPRESSED) {
+        circ_buffer.compressed += sign;
     }
-    
-    /*Guardar un nuevo mensaje en el buffer:
-    *Actualza head circularmente
-    *Incrementa el contador count
-    *Actualzia el último mensaje con set_last_message
-    */
-    if (circ_buffer.entries[circ_buffer.head]) { 
-        kfree(circ_buffer.entries[circ_buffer.head]);
+}
+
+/*Cursor de lectura sobre el buffer circular:
+*seq, partial: siguiente entrada por copiar y bytes ya copiados de ella
+*end: número de secuencia donde se detiene la copia (exclusivo)
+*room: bytes que aún caben en el buffer del usuario
+*whole: si es verdadero solo se copian entradas que caben completas en room (consultas por ioctl)
+*full: (con whole) la copia se detuvo en una entrada que no cabía en room
+*paused: la última pasada de cursor_fill se detuvo después de revisar READ_SCAN_ENTRIES entradas, la copia sigue en otra pasada
+*entries: entradas copiadas completamente
+*remote: entradas copiadas completamente cuya memoria está en otro nodo NUMA que el CPU del lector
+*mask: clases de prioridad que se leen, las entradas de varias clases se mezclan por número de secuencia
+*from_ns, to_ns: solo se copian las entradas con timestamp dentro de [from_ns, to_ns]
+*/
+struct read_cursor {
+    u64 seq;
+    size_t partial;
+    u64 end;
+    u64 room;
+    bool whole;
+    bool full;
+    bool paused;
+    u32 entries;
+    u32 remote;
+    unsigned int mask;
+    u64 from_ns;
+    u64 to_ns;
+};
+
+/*Longitud máxima de un mensaje: max_entry_size, pero nunca menor a ENTRY_SIZE ni mayor a LARGE_ENTRY_LIMIT*/
+static size_t entry_limit(void) {
+    return clamp_t(size_t, READ_ONCE(max_entry_size), ENTRY_SIZE, LARGE_ENTRY_LIMIT);
+}
+
+/*Reserva una entrada con espacio para data_size bytes de mensaje:
+*kvmalloc usa kmalloc para entradas pequeñas y páginas de vmalloc para las grandes, sin pedir bloques contiguos enormes
+*alloc_size guarda lo que ocupa realmente la asignación para la contabilidad de memoria
+*Con GFP_NOWAIT kvmalloc solo intenta kmalloc, una entrada grande falla y la escritura se reintenta bloqueando
+*Con numa_local la entrada se reserva en el nodo del escritor, así la copia del mensaje no cruza de socket
+*/
+static struct chardev_entry *alloc_entry(size_t data_size, gfp_t gfp) {
+    struct chardev_entry *entry;
+    size_t size = struct_size(entry, data, data_size);
+
+    entry = kvmalloc_node(size, gfp, numa_local ? numa_node_id() : NUMA_NO_NODE);
+    if (!entry) {
+        return NULL;
     }
-    circ_buffer.entries[circ_buffer.head] = kbuf;
-    set_last_message(kbuf);
-    circ_buffer.entries[circ_buffer.head] = kbuf; 
-    circ_buffer.head = (circ_buffer.head + 1) % MAX_ENTRIES; 
-    circ_buffer.count++;
-    
-    /*Libera el buffer y restaura el estado de las interrupciones 
-    *Si se tuvo exito retorna el número de bytes escritos 
-    */
-    spin_unlock_irqrestore(&circ_buffer.lock, flags);
-    return len; 
+    if (is_vmalloc_addr(entry)) {
+        entry->alloc_size = PAGE_ALIGN(size);
+        entry->node = page_to_nid(vmalloc_to_page(entry));
+    } else {
+        entry->alloc_size = kmalloc_size_roundup(size);
+        entry->node = page_to_nid(virt_to_page(entry));
+    }
+    return entry;
 }
 
+/*Libera una lista de entradas enlazadas por next:
+*Un lector optimista puede estar copiando una entrada recién desalojada, por eso se libera después de un periodo de gracia de RCU
+*next se lee antes de liberar porque comparte espacio con rcu
+*/
+static void free_entries(struct chardev_entry *list) {
+    while (list) {
+        struct chardev_entry *next = list->next;
+
+        kvfree_rcu(list, rcu);
+        list = next;
+    }
+}
 
-/*Función para abrir el dispositivo:
-*Registra en en logs del kernel que se abrió el dispositivo
+/*Operaciones sobre el buffer de una clase, deben llamarse con circ_buffer.lock tomado y dentro de write_seqcount_begin/end:
+*ring_push: guarda la entrada en head, requiere que el buffer tenga espacio
+*evict_oldest: saca la entrada más antigua (tail) y la retorna para liberarla sin el spinlock, requiere count > 0.
+*Si era la más reciente de su clave en la clase también sale del índice por clave
+*lowest_ring: buffer no vacío de menor prioridad entre las clases hasta max_prio, NULL si todas están vacías
 */
-int dev_open(struct inode *inode, struct file *filep){
-	printk(KERN_INFO "Modulo: Mayor: %i, Menor: %i\n", imajor(inode), iminor(inode));
-	return 0;
+static void ring_push(struct chardev_ring *ring, struct chardev_entry *entry) {
+    WRITE_ONCE(ring->slots[ring->head].seq, entry->seq);
+    WRITE_ONCE(ring->slots[ring->head].timestamp, entry->timestamp);
+    WRITE_ONCE(ring->entries[ring->head], entry);
+    ring->head = (ring->head + 1) % ring->size;
+    ring->count++;
+    ring->bytes += entry->alloc_size;
+    circ_buffer.count++;
+    account_entry(entry, 1);
 }
 
-/*Función para cerrar el dispositivo:
-*Registra en logs del kernel que el archivo se cerró
+static struct chardev_entry *evict_oldest(struct chardev_ring *ring) {
+    struct chardev_entry *entry = ring->entries[ring->tail];
+
+    if (entry->flags & ENTRY_KEYED) {
+        keyindex_drop(entry->key_hash, entry->prio, entry->seq);
+    }
+    account_entry(entry, -1);
+    WRITE_ONCE(ring->entries[ring->tail], NULL);
+    ring->tail = (ring->tail + 1) % ring->size;
+    ring->count--;
+    ring->bytes -= entry->alloc_size;
+    circ_buffer.count--;
+    return entry;
+}
+
+static struct chardev_ring *lowest_ring(unsigned int max_prio) {
+    unsigned int p;
+
+    for (p = 0; p <= max_prio; p++) {
+        if (circ_buffer.rings[p].count > 0) {
+            return &circ_buffer.rings[p];
+        }
+    }
+    return NULL;
+}
+
+/*Shrinker:
+*count: el kernel pregunta cuántas entradas se podrían liberar
+*scan: libera hasta nr_to_scan entradas empezando por las más antiguas de la clase de menor prioridad
+*Así el buffer devuelve memoria cuando el sistema está bajo presión en lugar de mantenerla fija
 */
-int dev_release(struct inode *inode, struct file *filep){
-	printk(KERN_INFO "Modulo: Archivo cerrado");
-	return 0;
+static unsigned long shrink_count(struct shrinker *shrinker, struct shrink_control *sc) {
+    unsigned long count = READ_ONCE(circ_buffer.count);
+
+    return count ? count : SHRINK_EMPTY;
 }
 
-/*Función para limpiar el buffer*/
-void clear_chardev(void) {
-    /*Protección de buffer circular: 
-    *flags: variable para almacenar el estado de las interrupciones
-    *spin_lock_irqsave: bloquea el acceso al buffer y deshabilita interrupciones 
-    *Almacena el estado de las interrupciones en flags para restaurarlo después
-    */
-    unsigned long flags;
+static unsigned long shrink_scan(struct shrinker *shrinker, struct shrink_control *sc) {
+    struct chardev_entry *list = NULL;
+    unsigned long flags, freed = 0;
+
     spin_lock_irqsave(&circ_buffer.lock, flags);
-    
-    /*Bucle para liberar las entradas del buffer
-    *Despuess reinicia los índices y el contador a 0
-    */
-    for (int i = 0; i < MAX_ENTRIES; i++) {
-        kfree(circ_buffer.entries[i]);
-        circ_buffer.entries[i] = NULL;
+    write_seqcount_begin(&circ_buffer.seq);
+    while (freed < sc->nr_to_scan && circ_buffer.count > 0) {
+        struct chardev_ring *ring = lowest_ring(CHARDEV_PRIO_CRITICAL);
+        struct chardev_entry *entry = evict_oldest(ring);
+
+        ring->evicted++;
+        entry->next = list;
+        list = entry;
+        freed++;
     }
-    circ_buffer.head = 0;
-    circ_buffer.tail = 0;
-    circ_buffer.count = 0;
-    
-    //Restarua el estado de interrupciones
+    circ_buffer.shrinker_freed += freed;
+    write_seqcount_end(&circ_buffer.seq);
     spin_unlock_irqrestore(&circ_buffer.lock, flags);
+
+    free_entries(list);
+    return freed ? freed : SHRINK_STOP;
+}
+
+/*Registro del shrinker, desde la versión 6.7 el kernel lo reserva con shrinker_alloc()*/
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+static struct shrinker *chardev_shrinker;
+
+static int shrinker_start(void) {
+    chardev_shrinker = shrinker_alloc(0, DEVICE_NAME);
+    if (!chardev_shrinker) {
+        return -ENOMEM;
+    }
+    chardev_shrinker->count_objects = shrink_count;
+    chardev_shrinker->scan_objects = shrink_scan;
+    shrinker_register(chardev_shrinker);
+    return 0;
+}
+
+static void shrinker_stop(void) {
+    shrinker_free(chardev_shrinker);
+    chardev_shrinker = NULL;
+}
+#else
+static struct shrinker chardev_shrinker = {
+    .count_objects = shrink_count,
+    .scan_objects = shrink_scan,
+    .seeks = DEFAULT_SEEKS,
+};
+
+static int shrinker_start(void) {
+    return register_shrinker(&chardev_shrinker, DEVICE_NAME);
+}
+
+static void shrinker_stop(void) {
+    unregister_shrinker(&chardev_shrinker);
+}
+#endif
+
+//Libera los buffers del módulo (límite de tasa, compresión, índice por clave y buffers circulares), cada uno puede no estar reservado
+static void free_buffers(void) {
+    ratelimit_exit();
+    compress_exit();
+    keyindex_exit();
+    rings_free();
+}
+
+//Libera los recursos auxiliares (shrinker, familia de netlink y buffers) si falla la inicialización del dispositivo
+static void release_aux(void) {
+    shrinker_stop();
+    netlink_exit();
+    free_buffers();
+}
+
+/*Memoria auxiliar: arreglos de los buffers circulares, buffers de compresión, cubetas del límite de tasa y estado de los descriptores abiertos*/
+static u64 aux_bytes(void) {
+    u64 rings = 0;
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        rings += (u64)circ_buffer.rings[p].size * (sizeof(*circ_buffer.rings[p].entries) + sizeof(*circ_buffer.rings[p].slots));
+    }
+    return rings + compress_memory() + ratelimit_memory() + atomic_read(&open_files) * sizeof(struct chardev_file);
+}
+
+/*Aviso de repeticiones que se muestra después de una entrada agrupada con dedup:
+*Se escribe en note y retorna su longitud, 0 si la entrada no se repitió
+*Si el mensaje no termina en salto de línea el aviso empieza en una línea nueva
+*/
+static size_t repeat_note(const struct chardev_entry *entry, const char *data, char *note, size_t size) {
+    if (entry->repeat == 0) {
+        return 0;
+    }
+    return scnprintf(note, size, "%s(mensaje anterior repetido %u veces)\n",
+                     (entry->len > 0 && data[entry->len - 1] == '\n') ? "" : "\n", entry->repeat);
+}
+
+/*Partes de una entrada tal como se entrega al usuario:
+*Texto: el mensaje seguido del aviso de repeticiones
+*Binario: el encabezado chardev_record, el mensaje y el relleno hasta CHARDEV_RECORD_ALIGN
+*head y tail deben tener espacio para el encabezado y el aviso. Retorna el total de bytes de la entrada
+*/
+struct entry_parts {
+    const char *ptr[3];
+    size_t len[3];
+};
+
+static size_t entry_layout(const struct chardev_file *file, const struct chardev_entry *entry, const char *data,
+                           struct chardev_record *head, char *tail, size_t tail_size, struct entry_parts *parts) {
+    parts->ptr[1] = data;
+    parts->len[1] = entry->len;
+    if (file->format == CHARDEV_FORMAT_BINARY) {
+        memset(head, 0, sizeof(*head));
+        head->len = entry->len;
+        head->repeat = entry->repeat;
+        head->seq = entry->seq;
+        head->timestamp = entry->timestamp;
+        head->prio = entry->prio;
+        head->flags = (entry->flags & ENTRY_COMPRESSED) ? CHARDEV_RECORD_COMPRESSED : 0;
+        head->weight = entry->weight;
+        parts->ptr[0] = (const char *)head;
+        parts->len[0] = sizeof(*head);
+        memset(tail, 0, CHARDEV_RECORD_ALIGN);
+        parts->ptr[2] = tail;
+        parts->len[2] = CHARDEV_RECORD_SIZE(entry->len) - sizeof(*head) - entry->len;
+    } else {
+        parts->ptr[0] = NULL;
+        parts->len[0] = 0;
+        parts->ptr[2] = tail;
+        parts->len[2] = repeat_note(entry, data, tail, tail_size);
+    }
+    return parts->len[0] + parts->len[1] + parts->len[2];
+}
+
+//Copia a dst n bytes de la entrada a partir del byte from, recorriendo sus partes en orden
+static void copy_parts(char *dst, const struct entry_parts *parts, size_t from, size_t n) {
+    int k;
+
+    for (k = 0; k < 3 && n > 0; k++) {
+        size_t part;
+
+        if (from >= parts->len[k]) {
+            from -= parts->len[k];
+            continue;
+        }
+        part = min(parts->len[k] - from, n);
+        memcpy(dst, parts->ptr[k] + from, part);
+        dst += part;
+        n -= part;
+        from = 0;
+    }
+}
+
+/*Copia entradas desde el cursor al buffer temporal kbuf de tamaño cap y avanza el cursor:
+*Las entradas que no cumplen con el filtro se saltan sin copiarse
+*Cada entrada se entrega según el formato del descriptor (entry_layout)
+*Una entrada más grande que cap se copia por partes en llamadas sucesivas, así se entrega como una sola entrada lógica
+*Revisa a lo más READ_SCAN_ENTRIES entradas por llamada (cursor->paused)
+*Retorna los bytes colocados en kbuf. Debe llamarse dentro de read_stable
+*/
+static size_t cursor_fill(struct chardev_file *file, struct read_cursor *cursor, char *kbuf, size_t cap) {
+    unsigned int scanned = 0;
+    size_t size = 0;
+
+    cursor->end = min(cursor->end, READ_ONCE(circ_buffer.next_seq));
+    cursor->paused = false;
+
+    while (size < cap && cursor->room > 0) {
+        const struct ring_slot *slot;
+        struct chardev_entry *entry;
+        const char *data;
+        struct chardev_record head;
+        struct entry_parts parts;
+        char tail[64];
+        size_t total, chunk;
+
+        if (scanned++ == READ_SCAN_ENTRIES) {
+            cursor->paused = true;
+            break;
+        }
+        entry = find_entry(cursor->seq, cursor->mask, &slot);
+
+        /*Sin más entradas de las clases leídas la posición pasa al final, así poll no la vuelve a reportar como legible*/
+        if (!entry || entry->seq >= cursor->end) {
+            cursor->seq = cursor->end;
+            cursor->partial = 0;
+            break;
+        }
+
+        /*Si la entrada del cursor ya fue desalojada (o es de otra clase) se continúa desde la siguiente*/
+        if (entry->seq != cursor->seq) {
+            cursor->seq = entry->seq;
+            cursor->partial = 0;
+        }
+
+        data = entry_data(entry);
+        if (!data || entry->timestamp < cursor->from_ns || entry->timestamp > cursor->to_ns ||
+            !filter_match(&file->filter, data, entry->len)) {
+            cursor->seq++;
+            continue;
+        }
+        total = entry_layout(file, entry, data, &head, tail, sizeof(tail), &parts);
+        if (cursor->whole && cursor->partial == 0 && total > cursor->room) {
+            cursor->end = cursor->seq;
+            cursor->full = true;
+            break;
+        }
+
+        /*La parte pendiente puede abarcar varias partes de la entrada (encabezado, mensaje, aviso o relleno)*/
+        chunk = min3(total - min(cursor->partial, total), cap - size, (size_t)cursor->room);
+        copy_parts(kbuf + size, &parts, cursor->partial, chunk);
+
+        /*Si el slot de la entrada cambió durante la copia un escritor la desalojó: lo copiado se descarta
+        *y se sigue con la siguiente, igual que si se hubiera desalojado antes de la lectura
+        */
+        if (READ_ONCE(slot->seq) != entry->seq) {
+            cursor->seq++;
+            cursor->partial = 0;
+            continue;
+        }
+        size += chunk;
+        cursor->room -= chunk;
+        cursor->partial += chunk;
+        if (cursor->partial < total) {
+            break;
+        }
+        cursor->seq++;
+        cursor->partial = 0;
+        cursor->entries++;
+        if (entry->node != numa_node_id()) {
+            cursor->remote++;
+        }
+    }
+    return size;
+}
+
+//Suma a los contadores NUMA del CPU las entradas que copió una lectura desde el estado start del cursor
+static void count_reads(const struct read_cursor *start, const struct read_cursor *cursor) {
+    u32 remote = cursor->remote - start->remote;
+
+    this_cpu_add(numa_ops.remote_reads, remote);
+    this_cpu_add(numa_ops.local_reads, cursor->entries - start->entries - remote);
+}
+
+/*Lectura optimista del buffer:
+*bounds (opcional) ubica el cursor y cursor_fill copia las entradas a kbuf sin tomar circ_buffer.lock, así los escritores nunca esperan a un lector
+*Los límites y la búsqueda de cada entrada son búsquedas binarias dentro de una sección del seqcount, solo esas se repiten si un escritor
+*cambió el buffer. La copia de una entrada no se repite: la lectura de RCU evita que se libere mientras se copia y cursor_fill
+*salta la entrada si se desalojó durante la copia
+*La expropiación queda deshabilitada durante cada pasada por el buffer de descompresión por CPU, y una pasada revisa a lo más
+*READ_SCAN_ENTRIES entradas. Si la pasada se detuvo sin copiar nada (el filtro o la ventana de tiempo descartaron todas)
+*se cede el CPU y se sigue con otra, si ya copió algo se retorna una lectura corta
+*Retorna los bytes colocados en kbuf
+*/
+static size_t read_stable(struct chardev_file *file, struct read_cursor *cursor, char *kbuf, size_t cap,
+                          void (*bounds)(const void *, struct read_cursor *), const void *arg) {
+    struct read_cursor start = *cursor;
+    unsigned int seq;
+    size_t size;
+
+    for (;;) {
+        preempt_disable();
+        rcu_read_lock();
+        if (bounds) {
+            do {
+                seq = read_seqcount_begin(&circ_buffer.seq);
+                *cursor = start;
+                bounds(arg, cursor);
+            } while (read_seqcount_retry(&circ_buffer.seq, seq));
+            bounds = NULL;
+        }
+        size = cursor_fill(file, cursor, kbuf, cap);
+        rcu_read_unlock();
+        preempt_enable();
+        if (size > 0 || !cursor->paused) {
+            break;
+        }
+        cond_resched();
+    }
+    count_reads(&start, cursor);
+    return size;
+}
+
+/*Posición del modo "last": número de secuencia de la entrada más reciente de las clases de mask que cumple con el filtro
+*del descriptor, next_seq si ninguna cumple
+*Cada clase se recorre hacia atrás desde su entrada más reciente (prev_in_ring) hasta la primera que cumple, sin pasar de la mejor
+*encontrada en otra clase. Cada entrada se revisa en su propia sección de RCU y se cede el CPU cada READ_SCAN_ENTRIES entradas,
+*así un filtro que no coincide con ninguna entrada no recorre millones de entradas con la expropiación deshabilitada
+*/
+static u64 last_seq(const struct chardev_file *file, unsigned int mask) {
+    u64 next = READ_ONCE(circ_buffer.next_seq), best = next;
+    unsigned int scanned = 0;
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        u64 below = next;
+        bool match = false;
+
+        if (!(mask & CHARDEV_PRIO_MASK(p))) {
+            continue;
+        }
+        while (!match) {
+            struct chardev_entry *entry;
+
+            if (++scanned % READ_SCAN_ENTRIES == 0) {
+                cond_resched();
+            }
+            preempt_disable();
+            rcu_read_lock();
+            entry = prev_in_ring(&circ_buffer.rings[p], below);
+            if (entry && (best == next || entry->seq > best)) {
+                const char *data = entry_data(entry);
+
+                match = data && filter_match(&file->filter, data, entry->len);
+                below = entry->seq;
+            } else {
+                entry = NULL;
+            }
+            rcu_read_unlock();
+            preempt_enable();
+            if (!entry) {
+                break;
+            }
+        }
+        if (match) {
+            best = below;
+        }
+    }
+    return best;
+}
+
+/*Funcion de lectura del dispositivo:
+*Se usa para read, readv e io_uring. La lectura nunca espera entradas nuevas, al final del buffer retorna 0
+*Con IOCB_NOWAIT (io_uring, RWF_NOWAIT) el buffer temporal se reserva sin dormir y si no hay memoria retorna -EAGAIN,
+*así io_uring completa la lectura en el mismo envío en lugar de mandarla a un hilo de trabajo
+*/
+ssize_t dev_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+
+    /*output_buffer: buffer temporal en el espacio kernel, se reserva antes de copiar las entradas
+    *cap: tamaño de output_buffer, acotado a READ_BUFFER_SIZE
+    *output_size: bytes colocados en output_buffer
+    *cursor: posición de lectura (número de secuencia y bytes ya leídos de esa entrada)
+    *last: modo "last" de esta lectura
+    *flags: variable para guardar el estado de las interrupciones
+    *ret: variable de retorno para los bytes leídos o error 
+    */
+    unsigned long flags;
+    char *output_buffer; 
+    size_t cap, output_size, len = iov_iter_count(to);
+    struct chardev_file *file = iocb->ki_filp->private_data;
+    struct read_cursor cursor = { .end = U64_MAX, .room = len, .mask = file->read_mask, .to_ns = U64_MAX };
+    bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+    bool last = false;
+    ssize_t ret; 
+
+    if (len == 0) {
+        return 0;
+    }
+
+    /*Asigna el buffer temporal antes de copiar, GFP_KERNEL puede dormir y la copia se hace con la expropiación deshabilitada*/
+    cap = min_t(size_t, len, READ_BUFFER_SIZE);
+    output_buffer = kvmalloc(cap, nowait ? GFP_NOWAIT : GFP_KERNEL);
+    if (!output_buffer) {
+        return nowait ? -EAGAIN : -ENOMEM;
+    }
+
+    /*Posición inicial:
+    *La posición ki_pos es el número de secuencia de la siguiente entrada por leer
+    *Solo se retoma una entrada parcial si el descriptor quedó en esa misma entrada
+    */
+    cursor.seq = iocb->ki_pos;
+    cursor.partial = (file->partial_seq == cursor.seq) ? file->partial : 0;
+    
+    /*Modo de operación "last": 
+    *Se activa cuando command_mode contiene "last" y solo dura una lectura
+    *Mueve la posición al mensaje más reciente que cumple con el filtro del descriptor (last_seq), las lecturas siguientes
+    *terminan de entregarlo si es más grande que el buffer del usuario
+    *El modo se consume con el spinlock tomado para que solo una lectura lo use, es el único caso en que la lectura lo toma
+    */
+    if (strcmp(command_mode, "last") == 0){
+        spin_lock_irqsave(&circ_buffer.lock, flags);
+        last = strcmp(command_mode, "last") == 0;
+        strcpy(command_mode, "");
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    }
+
+    if (last) {
+        cursor.seq = last_seq(file, cursor.mask);
+        cursor.partial = 0;
+    }
+
+    /*Copia las entradas desde la posición hasta llenar el buffer temporal, sin bloquear a los escritores*/
+    output_size = read_stable(file, &cursor, output_buffer, cap, NULL, NULL);
+
+    /*Copiar al espacio usuario
+    *EFAULT indica error al copiar, dirección invalida. En ese caso no se mueve la posición de lectura
+    */
+    ret = output_size;
+    if (output_size > 0 && copy_to_iter(output_buffer, output_size, to) != output_size) {
+        ret = -EFAULT;
+    } else {
+        /*Actualización de estado: la posición queda en la siguiente entrada por leer*/
+        iocb->ki_pos = cursor.seq;
+        file->partial_seq = cursor.seq;
+        file->partial = cursor.partial;
+
+        /*El avance del lector mide cuánto se consume, el modo "last" salta al final sin consumir*/
+        if (!last) {
+            overload_consumed(&file->reader, cursor.seq,
+                              file->read_mask == CHARDEV_PRIO_ALL && file->filter.type == CHARDEV_FILTER_NONE);
+        }
+    }
+
+    /*Libera la memoria del buffer temporal*/
+    kvfree(output_buffer);
+
+    /*Retorna el número de bytes copiados o error*/
+    return ret;
+}
+
+/*Nueva posición de lectura para llseek, whence ya es SEEK_SET, SEEK_CUR o SEEK_END
+*Se llama con circ_buffer.lock tomado o en una lectura optimista (sección de RCU y seqcount)
+*/
+static loff_t seek_pos(const struct chardev_file *file, loff_t f_pos, loff_t offset, int whence) {
+    unsigned int mask = file->read_mask;
+    loff_t pos;
+
+    if (whence == SEEK_SET) {
+        pos = offset;
+    } else if (whence == SEEK_CUR) {
+        pos = f_pos + offset;
+    } else if (offset < 0) {
+        s64 index = (s64)count_entries(mask) + offset;
+
+        pos = index >= 0 ? seq_at_index(mask, index) : oldest_seq(mask);
+    } else {
+        pos = READ_ONCE(circ_buffer.next_seq) + offset;
+    }
+
+    /*Si la posición cae antes de la entrada más antigua de las clases del descriptor (pero no es negativa) se ajusta a ella*/
+    if (pos >= 0) {
+        pos = clamp_t(loff_t, pos, oldest_seq(mask), READ_ONCE(circ_buffer.next_seq));
+    }
+    return pos;
+}
+
+/*Función para mover la posición de lectura:
+*La posición es el número de secuencia de la entrada, SEEK_END con offset -N deja listas las últimas N entradas de las clases que lee el descriptor
+*SEEK_SET usa números de secuencia absolutos, si la entrada ya fue desalojada se ajusta a la más antigua de las clases que lee
+*La posición se calcula sin spinlock como en las lecturas, y solo se toma si los escritores cambian el buffer en cada intento
+*Retorna la nueva posición o -EINVAL si queda antes del inicio
+*/
+loff_t dev_llseek(struct file *filep, loff_t offset, int whence) {
+    struct chardev_file *file = filep->private_data;
+    unsigned long flags;
+    unsigned int seq, tries;
+    loff_t pos;
+
+    if (whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END) {
+        return -EINVAL;
+    }
+    for (tries = 0; tries < READ_RETRIES; tries++) {
+        rcu_read_lock();
+        seq = read_seqcount_begin(&circ_buffer.seq);
+        pos = seek_pos(file, filep->f_pos, offset, whence);
+        rcu_read_unlock();
+        if (!read_seqcount_retry(&circ_buffer.seq, seq)) {
+            break;
+        }
+    }
+    if (tries == READ_RETRIES) {
+        spin_lock_irqsave(&circ_buffer.lock, flags);
+        pos = seek_pos(file, filep->f_pos, offset, whence);
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    }
+
+    if (pos < 0) {
+        return -EINVAL;
+    }
+    filep->f_pos = pos;
+    file->partial = 0;
+    return pos;
+}
+
+/*Función de poll:
+*El dispositivo siempre acepta escrituras, y es legible cuando la posición del descriptor no ha llegado a la entrada más reciente
+*Las entradas pendientes pueden no cumplir el filtro, en ese caso la lectura retorna 0 y avanza la posición
+*/
+__poll_t dev_poll(struct file *filep, struct poll_table_struct *wait) {
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;
+
+    poll_wait(filep, &read_wait, wait);
+    if (filep->f_pos < READ_ONCE(circ_buffer.next_seq)) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    return mask;
+}
+     
+
+
+/*Agrupación de un mensaje repetido con la entrada más reciente de su clase:
+*Compara primero longitud y hash, y solo si coinciden compara el contenido
+*Si es el mismo mensaje incrementa repeat, suma el peso de la escritura (weight) y actualiza el timestamp
+*(el buffer sigue ordenado por tiempo)
+*Retorna verdadero si el mensaje se agrupó. Debe llamarse con circ_buffer.lock tomado, el cambio se marca en el seqcount
+*/
+static bool repeat_newest(struct chardev_ring *ring, const char *data, size_t len, u64 hash, unsigned int weight) {
+    struct chardev_entry *newest;
+    const char *newest_data;
+
+    if (ring->count == 0) {
+        return false;
+    }
+    newest = ring_at(ring, ring->count - 1);
+    if (!(newest->flags & ENTRY_HASHED) || newest->hash != hash || newest->len != len) {
+        return false;
+    }
+    newest_data = entry_data(newest);
+    if (!newest_data || memcmp(newest_data, data, len) != 0) {
+        return false;
+    }
+    write_seqcount_begin(&circ_buffer.seq);
+    newest->repeat++;
+    newest->weight += weight;
+    newest->timestamp = ktime_get_ns();
+    WRITE_ONCE(ring->slots[(ring->tail + ring->count - 1) % ring->size].timestamp, newest->timestamp);
+    write_seqcount_end(&circ_buffer.seq);
+    circ_buffer.repeated++;
+    return true;
+}
+
+/*Compresión de una entrada nueva:
+*Si la compresión está activa y reduce el tamaño, retorna una entrada nueva con el mensaje comprimido
+*En cualquier otro caso (desactivada, sin memoria, no conviene) retorna la misma entrada sin comprimir
+*Con nowait no se espera por el contexto de compresión ni se duerme al reservar
+*/
+static struct chardev_entry *pack_entry(struct chardev_entry *entry, bool nowait) {
+    struct compress_ctx *ctx;
+    struct chardev_entry *packed;
+    const char *out;
+    size_t out_len;
+
+    if (!compress_enabled()) {
+        return entry;
+    }
+    ctx = compress_get(entry->data, entry->len, &out, &out_len, nowait);
+    if (!ctx) {
+        return entry;
+    }
+
+    packed = alloc_entry(out_len, nowait ? GFP_NOWAIT : GFP_KERNEL);
+    if (packed) {
+        memcpy(packed->data, out, out_len);
+        packed->len = entry->len;
+        packed->stored_len = out_len;
+        packed->prio = entry->prio;
+        packed->flags = ENTRY_COMPRESSED | (entry->flags & (ENTRY_HASHED | ENTRY_KEYED));
+        packed->repeat = 0;
+        packed->weight = entry->weight;
+        packed->hash = entry->hash;
+        packed->key_hash = entry->key_hash;
+    }
+    compress_put(ctx);
+    return packed ? packed : entry;
+}
+
+/*Clave de una entrada nueva (parámetro keyed):
+*Si el mensaje empieza con "clave=" marca la entrada con ENTRY_KEYED y retorna la longitud de la clave, 0 si no tiene clave
+*El nodo de una clave nueva se reserva en *spare antes de tomar el spinlock, retorna -ENOMEM si no hay memoria
+*/
+static int key_entry(struct chardev_entry *entry, struct key_node **spare, gfp_t gfp) {
+    size_t key_len;
+
+    *spare = NULL;
+    if (!keyindex_enabled()) {
+        return 0;
+    }
+    key_len = keyindex_key(entry->data, entry->len);
+    if (key_len == 0) {
+        return 0;
+    }
+    entry->key_hash = keyindex_hash(entry->data, key_len);
+    *spare = keyindex_prepare(entry->data, key_len, entry->key_hash, gfp);
+    if (IS_ERR(*spare)) {
+        *spare = NULL;
+        return -ENOMEM;
+    }
+    entry->flags |= ENTRY_KEYED;
+    return key_len;
+}
+
+/*Escritura de un mensaje:
+*Guarda una entrada con todos los bytes que quedan en el iov_iter
+*record_prio: clase del registro en una escritura binaria, o -1 para usar la del descriptor o la del byte de prioridad
+*Los registros binarios no se interpretan como comandos (CLEAR, LAST) ni llevan byte de prioridad
+*Con IOCB_NOWAIT las reservas no duermen y si no hay memoria retorna -EAGAIN, io_uring reintenta en un hilo de trabajo
+*Retorna la longitud del mensaje o error
+*/
+static ssize_t write_message(struct kiocb *iocb, struct iov_iter *from, int record_prio) {
+    
+    /*flags: almacena el estado de las interrupciones
+    *len: bytes del mensaje (suma de los segmentos, sin el byte de prioridad)
+    *written: bytes recibidos, es lo que se retorna al usuario
+    *entry: nueva entrada en el espacio kernel dónde se copian los datos del usuario
+    *stored: entrada que se guarda en el buffer (entry o su versión comprimida)
+    *evicted: lista de entradas desalojadas, se liberan después de soltar el spinlock porque kvfree puede dormir
+    *budget: copia del parámetro max_bytes
+    *nowait, gfp: la escritura no puede bloquear (IOCB_NOWAIT) y las reservas usan GFP_NOWAIT
+    *nl: mensaje de netlink propio para una entrada que no cabe en un lote (netlink_prepare)
+    */
+    unsigned long flags, budget;
+    size_t len = iov_iter_count(from), written = len;
+    struct chardev_entry *entry, *stored, *evicted = NULL;
+    struct sk_buff *nl;
+    bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+    gfp_t gfp = nowait ? GFP_NOWAIT : GFP_KERNEL;
+
+    /*Clase de prioridad:
+    *prio: clase de la entrada, la del descriptor o la del byte de prioridad al inicio del mensaje
+    *ring: buffer circular de la clase
+    *tag: primer byte de un mensaje grande, para reconocer el byte de prioridad
+    */
+    struct chardev_file *file = iocb->ki_filp->private_data;
+    unsigned int prio = record_prio >= 0 ? record_prio : file->write_prio;
+    struct chardev_ring *ring;
+    char tag;
+    int ret;
+
+    /*Detección de repetidos:
+    *dedup_on: copia del parámetro dedup para usar el mismo valor en toda la escritura
+    *small: copia de los mensajes de hasta ENTRY_SIZE, sirve para reconocer los comandos y calcular el hash antes de reservar memoria
+    *in_small: el mensaje está en small
+    *hash: xxh64 del mensaje
+    */
+    bool dedup_on = READ_ONCE(dedup);
+    char small[ENTRY_SIZE];
+    bool in_small = len <= ENTRY_SIZE;
+    u64 hash = 0;
+
+    /*Índice por clave:
+    *key_len: longitud de la clave del mensaje, 0 si no tiene o el índice está apagado
+    *spare: nodo reservado para una clave que no estaba en el índice, se libera si no se usa
+    */
+    int key_len;
+    struct key_node *spare;
+
+    //weight: escrituras que representa la entrada según el muestreo en sobrecarga, 0 si se descarta
+    unsigned int weight;
+    
+    /*Condicional para validar la longitud de los datos (entry_limit)*/
+    if (len == 0 || len > entry_limit()) {
+        return -EINVAL;
+    }
+
+    /*Los mensajes cortos se copian a la pila antes de compararlos, los comandos no se leen directamente de la memoria del usuario*/
+    if (in_small && copy_from_iter(small, len, from) != len) {
+        return -EFAULT;
+    }
+
+    /*Manejo de comando CLEAR, reserva los arreglos vacíos y puede dormir, con IOCB_NOWAIT se reintenta bloqueando:*/
+    if (record_prio < 0 && len == 5 && strncmp(small, "CLEAR", 5) == 0) {
+        if (nowait) {
+            return -EAGAIN;
+        }
+        clear_chardev();
+        return len;
+    }
+
+    /*Manejo del comando LAST:
+    *Verifica que el mensaje es "LAST"
+    *copia la cadena "last" en command_mode para activar el modo(se usa strcpy porque el origen es mas corto que el destino)
+    *Garantiza la terminación nula de "last" para evitar errores si strcpy falla
+    */
+    else if (record_prio < 0 && len == 4 && strncmp(small, "LAST", 4) == 0){
+        strcpy(command_mode, "last");
+        command_mode[sizeof(command_mode)-1] = '\0';
+        return len;
+    }
+
+    /*Límite de tasa:
+    *Se cobra antes de reservar memoria o tomar el spinlock, así un escritor desbocado no compite por el buffer
+    *Una escritura descartada se reporta como exitosa al escritor, una rechazada retorna -EAGAIN
+    */
+    ret = ratelimit_check(iocb->ki_filp);
+    if (ret) {
+        return ret == RATE_DROPPED ? written : ret;
+    }
+
+    /*Muestreo en sobrecarga:
+    *Si los lectores no alcanzan a consumir las entradas solo se guarda 1 de cada weight escrituras, las demás se aceptan
+    *sin reservar, copiar ni desalojar. La entrada que se guarda lleva su peso para que los lectores escalen sus cuentas
+    */
+    weight = overload_check(READ_ONCE(circ_buffer.next_seq));
+    if (weight == 0) {
+        return written;
+    }
+
+    /*Byte de prioridad:
+    *Si el mensaje empieza con CHARDEV_PRIO_TAG(p) se guarda con prioridad p y el byte se descarta
+    *En los mensajes grandes se lee solo el primer byte y si no es de prioridad se devuelve al iov_iter
+    */
+    if (record_prio >= 0) {
+        tag = 0;
+    } else if (in_small) {
+        tag = small[0];
+    } else if (copy_from_iter(&tag, 1, from) != 1) {
+        return -EFAULT;
+    }
+    if (record_prio < 0 && (u8)tag >= CHARDEV_PRIO_TAG_BASE && (u8)tag < CHARDEV_PRIO_TAG(CHARDEV_PRIO_COUNT)) {
+        prio = (u8)tag - CHARDEV_PRIO_TAG_BASE;
+        len--;
+        if (in_small) {
+            memmove(small, small + 1, len);
+        }
+    } else if (record_prio < 0 && !in_small) {
+        iov_iter_revert(from, 1);
+    }
+    if (len == 0) {
+        return -EINVAL;
+    }
+    
+    /*Mensajes cortos repetidos:
+    *Se comparan con la entrada más reciente de su clase antes de reservar memoria,
+    *así un productor que repite el mismo mensaje no reserva, no copia de nuevo ni desaloja entradas
+    */
+    if (dedup_on && in_small) {
+        hash = xxh64(small, len, 0);
+        spin_lock_irqsave(&circ_buffer.lock, flags);
+        if (repeat_newest(&circ_buffer.rings[prio], small, len, hash, weight)) {
+            spin_unlock_irqrestore(&circ_buffer.lock, flags);
+            return written;
+        }
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    }
+
+    /*Asignación de memoria:
+    *Se reserva la estructura de la entrada junto con len+1 bytes para incluir el terminador nulo
+    */
+    entry = alloc_entry(len + 1, gfp);
+    if (!entry) {
+        return nowait ? -EAGAIN : -ENOMEM;
+    }
+    
+    /*Copia los datos desde el espacio usuario en un solo copy_from_iter, aunque la entrada ocupe varias páginas
+    *Si el mensaje ya se copió a la pila se toma de ahí
+    */
+    if (in_small) {
+        memcpy(entry->data, small, len);
+    } else if (copy_from_iter(entry->data, len, from) != len) {
+        kvfree(entry); 
+        return -EFAULT;
+    } else if (dedup_on) {
+        hash = xxh64(entry->data, len, 0);
+    }
+    
+    entry->data[len] = '\0';
+    entry->len = len;
+    entry->stored_len = len;
+    entry->prio = prio;
+    entry->flags = dedup_on ? ENTRY_HASHED : 0;
+    entry->repeat = 0;
+    entry->weight = weight;
+    entry->hash = hash;
+
+    /*La clave se busca en el mensaje original, antes de comprimirlo*/
+    key_len = key_entry(entry, &spare, gfp);
+    if (key_len < 0) {
+        kvfree(entry);
+        return nowait ? -EAGAIN : -ENOMEM;
+    }
+
+    /*Compresión opcional, se hace antes de tomar el spinlock*/
+    stored = pack_entry(entry, nowait);
+
+    /*Una entrada que por sí sola supera el presupuesto de bytes no se puede guardar*/
+    budget = READ_ONCE(max_bytes);
+    if (budget && stored->alloc_size > budget) {
+        if (stored != entry) {
+            kvfree(stored);
+        }
+        kvfree(entry);
+        keyindex_put(spare);
+        return -ENOSPC;
+    }
+
+    /*El mensaje propio de netlink se reserva fuera del spinlock, con GFP_KERNEL puede dormir*/
+    nl = netlink_prepare(len, gfp);
+    
+    /*Protege el buffer de interrupciones y almacena el estado de las interrupciones en flags para restaurarlas
+    */
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    ring = &circ_buffer.rings[prio];
+
+    /*Un mensaje repetido se vuelve a revisar al publicar: los mensajes grandes solo se revisan aquí
+    *y otro escritor pudo publicar el mismo mensaje corto después de la primera revisión
+    */
+    if (dedup_on && repeat_newest(ring, entry->data, len, hash, weight)) {
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+        if (stored != entry) {
+            kvfree(stored);
+        }
+        kvfree(entry);
+        keyindex_put(spare);
+        netlink_put(nl);
+        return written;
+    }
+
+    /*Presupuesto de bytes:
+    *Solo se pueden desalojar entradas de la misma clase o de menor prioridad, si con ellas no alcanza la entrada se rechaza
+    *sin desalojar nada, así los mensajes de baja prioridad nunca desplazan a los críticos
+    */
+    if (budget && circ_buffer.entry_bytes + stored->alloc_size > budget) {
+        u64 reclaimable = 0;
+        unsigned int p;
+
+        for (p = 0; p <= prio; p++) {
+            reclaimable += circ_buffer.rings[p].bytes;
+        }
+        if (circ_buffer.entry_bytes - reclaimable + stored->alloc_size > budget) {
+            spin_unlock_irqrestore(&circ_buffer.lock, flags);
+            if (stored != entry) {
+                kvfree(stored);
+            }
+            kvfree(entry);
+            keyindex_put(spare);
+            netlink_put(nl);
+            return -ENOSPC;
+        }
+    }
+
+    /*La marca de tiempo se toma dentro del spinlock para que el orden de cada clase coincida con el orden temporal,
+    *así las consultas por rango de tiempo pueden usar búsqueda binaria
+    *Desde aquí hasta publicar la entrada el seqcount queda impar, los lectores que se crucen con el cambio repiten su copia
+    */
+    write_seqcount_begin(&circ_buffer.seq);
+    stored->timestamp = ktime_get_ns();
+    stored->seq = circ_buffer.next_seq++;
+
+    /*El índice apunta a la entrada nueva antes de desalojar, así si se desaloja la anterior de la misma clave
+    *el nodo de la clave se conserva (y los lectores no ven el cambio hasta cerrar el seqcount)
+    */
+    if (key_len > 0) {
+        keyindex_set(entry->data, key_len, stored->key_hash, prio, stored->seq, &spare);
+    }
+    
+    /*Manejo del buffer lleno (política FIFO):
+    *Si el buffer de la clase está lleno se elimina su mensaje más antiguo, las demás clases no se tocan
+    */
+    if (ring->count == ring->size) { 
+        evicted = evict_oldest(ring);
+        evicted->next = NULL;
+        ring->evicted++;
+    }
+
+    /*Se desalojan las entradas más antiguas de la clase de menor prioridad hasta que la nueva cabe en max_bytes*/
+    while (budget && circ_buffer.entry_bytes + stored->alloc_size > budget) {
+        struct chardev_ring *victim = lowest_ring(prio);
+        struct chardev_entry *oldest = evict_oldest(victim);
+
+        oldest->next = evicted;
+        evicted = oldest;
+        victim->evicted++;
+        circ_buffer.budget_evicted++;
+    }
+    
+    /*Guardar un nuevo mensaje en el buffer de su clase*/
+    ring_push(ring, stored);
+    write_seqcount_end(&circ_buffer.seq);
+    if (numa_node_id() == home_node) {
+        this_cpu_inc(numa_ops.local_writes);
+    } else {
+        this_cpu_inc(numa_ops.remote_writes);
+    }
+    
+    /*Libera el buffer y restaura el estado de las interrupciones 
+    *Si se tuvo exito retorna el número de bytes escritos 
+    *La sección de RCU empieza antes de soltar el spinlock: desde ahí otro escritor puede desalojar la entrada,
+    *y un desalojo posterior al inicio de la sección no la libera hasta que termine
+    */
+    rcu_read_lock();
+    spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    keyindex_put(spare);
+
+    /*Avisa a los lectores que esperan en poll que hay una entrada nueva*/
+    wake_up_interruptible_poll(&read_wait, EPOLLIN | EPOLLRDNORM);
+
+    /*Publica la entrada a los suscriptores de netlink, el mensaje siempre va sin comprimir (flags en 0)*/
+    {
+        struct chardev_record record = {
+            .len = len,
+            .seq = stored->seq,
+            .timestamp = stored->timestamp,
+            .prio = prio,
+            .weight = weight,
+        };
+
+        netlink_publish(&record, entry->data, nl);
+    }
+    rcu_read_unlock();
+
+    /*Cuenta la entrada en los eventfd registrados, cada uno avisa según sus umbrales*/
+    notify_entry(prio);
+
+    free_entries(evicted);
+    if (stored != entry) {
+        kvfree(entry);
+    }
+    return written; 
+}
+
+/*Escritura de varios registros (descriptor en formato binario):
+*El buffer es una secuencia de registros como los de la lectura binaria: encabezado chardev_record, mensaje y relleno
+*hasta CHARDEV_RECORD_ALIGN. Del encabezado solo se usan len y prio, cada registro se guarda como una entrada independiente
+*Así un escritor puede juntar muchos mensajes en una sola llamada al sistema sin mezclarlos en una entrada
+*Retorna los bytes de los registros guardados, o el error del primer registro si ninguno se guardó
+*/
+static ssize_t write_records(struct kiocb *iocb, struct iov_iter *from) {
+    size_t done = 0;
+    ssize_t ret = 0;
+
+    while (iov_iter_count(from) > 0) {
+        struct chardev_record head;
+        u64 size;
+        size_t rest;
+
+        if (iov_iter_count(from) < sizeof(head)) {
+            ret = -EINVAL;
+            break;
+        }
+        if (copy_from_iter(&head, sizeof(head), from) != sizeof(head)) {
+            ret = -EFAULT;
+            break;
+        }
+        /*head.len viene del usuario: se valida antes de usarlo para calcular el tamaño del registro o ajustar el iov_iter*/
+        if (head.len == 0 || head.len > entry_limit() || head.prio >= CHARDEV_PRIO_COUNT) {
+            ret = -EINVAL;
+            break;
+        }
+        size = CHARDEV_RECORD_SIZE(head.len);
+        if (size - sizeof(head) > iov_iter_count(from)) {
+            ret = -EINVAL;
+            break;
+        }
+
+        /*El iov_iter se limita al mensaje del registro, y después se salta lo que no se consumió y el relleno*/
+        rest = iov_iter_count(from) - head.len;
+        iov_iter_truncate(from, head.len);
+        ret = write_message(iocb, from, head.prio);
+        iov_iter_reexpand(from, iov_iter_count(from) + rest);
+        if (ret < 0) {
+            break;
+        }
+        iov_iter_advance(from, iov_iter_count(from) - rest + (size - sizeof(head) - head.len));
+        done += size;
+    }
+    return done ? done : ret;
+}
+
+/*Funcion de esccritura en el dispositivo:
+*Se usa para write, writev e io_uring
+*En formato de texto cada llamada guarda una entrada con todos los segmentos del iov_iter,
+*en formato binario cada llamada puede llevar varios registros (write_records)
+*/
+ssize_t dev_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    struct chardev_file *file = iocb->ki_filp->private_data;
+
+    if (file->format == CHARDEV_FORMAT_BINARY) {
+        return write_records(iocb, from);
+    }
+    return write_message(iocb, from, -1);
+}
+
+
+/*Búsqueda binaria sobre el buffer de una clase, ordenado por tiempo:
+*Devuelve el índice lógico (0 es la entrada más antigua, en tail) de la primera entrada cuyo timestamp es mayor o igual a ns
+*Si upper es verdadero busca la primera entrada con timestamp estrictamente mayor a ns
+*Debe llamarse con circ_buffer.lock tomado o dentro de read_stable
+*/
+static unsigned int find_by_time(const struct chardev_ring *ring, u64 ns, bool upper) {
+    unsigned int lo = 0, hi = READ_ONCE(ring->count);
+
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        u64 ts = slot_time(ring, mid);
+
+        if (ts < ns || (upper && ts == ns)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*Límites del cursor para cada tipo de consulta, se llaman dentro de read_stable con cursor->mask ya definido:
+*time_bounds: en cada clase se buscan por búsqueda binaria la primera y la última entrada dentro de [from_ns, to_ns],
+*el cursor va de la primera a la última de todas las clases y descarta las que quedan fuera de la ventana
+*index_bounds: count entradas desde first, un first negativo cuenta desde la entrada más reciente (-1 es la última)
+*/
+static void time_bounds(const void *arg, struct read_cursor *cursor) {
+    const struct chardev_time_query *query = arg;
+    int p;
+
+    cursor->from_ns = query->from_ns;
+    cursor->to_ns = query->to_ns;
+    cursor->seq = U64_MAX;
+    cursor->end = 0;
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        const struct chardev_ring *ring = &circ_buffer.rings[p];
+        unsigned int first, last;
+
+        if (!(cursor->mask & CHARDEV_PRIO_MASK(p))) {
+            continue;
+        }
+        first = find_by_time(ring, query->from_ns, false);
+        last = find_by_time(ring, query->to_ns, true);
+        if (first >= last) {
+            continue;
+        }
+        cursor->seq = min(cursor->seq, slot_seq(ring, first));
+        cursor->end = max(cursor->end, slot_seq(ring, last - 1) + 1);
+    }
+    if (cursor->seq == U64_MAX) {
+        cursor->seq = 0;
+    }
+}
+
+static void index_bounds(const void *arg, struct read_cursor *cursor) {
+    const struct chardev_range_query *query = arg;
+    s64 total = count_entries(cursor->mask);
+    s64 start = query->first;
+
+    if (start < 0) {
+        start = max_t(s64, start + total, 0);
+    }
+    start = min_t(s64, start, total);
+    cursor->seq = seq_at_index(cursor->mask, start);
+    cursor->end = seq_at_index(cursor->mask, min_t(s64, start + query->count, total));
+}
+
+/*Copia de un rango de entradas al espacio usuario:
+*bounds calcula el rango, así solo se recorren las entradas del rango sin escanear el buffer completo
+*La copia se hace en bloques de READ_BUFFER_SIZE: se llena el buffer temporal con una lectura optimista (read_stable) y se copia al usuario
+*Se aplican el filtro y las clases de prioridad del descriptor y solo se copian entradas completas
+*copied, entries: (salida) bytes y entradas copiadas
+*truncated: (salida, puede ser NULL) quedaron entradas del rango sin copiar porque no cabían en buf_len
+*/
+static long copy_entries(struct chardev_file *file, void (*bounds)(const void *, struct read_cursor *), const void *query,
+                         u64 ubuf, u64 buf_len, u64 *copied, u32 *entries, bool *truncated) {
+    struct read_cursor cursor = { .room = buf_len, .whole = true, .mask = file->read_mask, .to_ns = U64_MAX };
+    char *kbuf;
+    size_t cap, size;
+    long ret = 0;
+
+    cap = min_t(u64, buf_len, READ_BUFFER_SIZE);
+    kbuf = kvmalloc(max_t(size_t, cap, 1), GFP_KERNEL);
+    if (!kbuf) {
+        return -ENOMEM;
+    }
+
+    /*Los límites se calculan en la misma lectura optimista que el primer bloque*/
+    *copied = 0;
+    size = read_stable(file, &cursor, kbuf, cap, bounds, query);
+    while (size > 0) {
+        if (copy_to_user(u64_to_user_ptr(ubuf + *copied), kbuf, size) != 0) {
+            ret = -EFAULT;
+            break;
+        }
+        *copied += size;
+        size = read_stable(file, &cursor, kbuf, cap, NULL, NULL);
+    }
+
+    *entries = cursor.entries;
+    if (truncated) {
+        *truncated = cursor.full;
+    }
+    kvfree(kbuf);
+    return ret;
+}
+
+/*Consulta por rango de tiempo:
+*Copia al buffer de usuario las entradas completas con timestamp dentro de [from_ns, to_ns]
+*Retorna -EMSGSIZE si la primera entrada del rango no cabe, y si cupo solo una parte del rango lo marca con CHARDEV_QUERY_TRUNCATED,
+*en los dos casos el usuario repite con un buffer más grande
+*/
+static long time_range_query(struct chardev_file *file, struct chardev_time_query __user *uquery) {
+    struct chardev_time_query query;
+    bool truncated;
+    long ret;
+
+    if (copy_from_user(&query, uquery, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+    if (query.from_ns > query.to_ns) {
+        return -EINVAL;
+    }
+
+    ret = copy_entries(file, time_bounds, &query, query.buf, query.buf_len, &query.copied, &query.entries, &truncated);
+    if (ret) {
+        return ret;
+    }
+    if (query.entries == 0 && truncated) {
+        return -EMSGSIZE;
+    }
+    query.flags = truncated ? CHARDEV_QUERY_TRUNCATED : 0;
+
+    /*Copia los contadores de salida al espacio usuario*/
+    if (copy_to_user(uquery, &query, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/*Consulta por rango de índices:
+*Copia al buffer de usuario las entradas completas desde el índice first, sin leer el resto del buffer
+*Retorna -EMSGSIZE si la primera entrada del rango no cabe, y marca con CHARDEV_QUERY_TRUNCATED un rango copiado en parte
+*/
+static long index_range_query(struct chardev_file *file, struct chardev_range_query __user *uquery) {
+    struct chardev_range_query query;
+    bool truncated;
+    long ret;
+
+    if (copy_from_user(&query, uquery, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+
+    ret = copy_entries(file, index_bounds, &query, query.buf, query.buf_len, &query.copied, &query.entries, &truncated);
+    if (ret) {
+        return ret;
+    }
+    if (query.entries == 0 && truncated) {
+        return -EMSGSIZE;
+    }
+    query.flags = truncated ? CHARDEV_QUERY_TRUNCATED : 0;
+
+    /*Copia los contadores de salida al espacio usuario*/
+    if (copy_to_user(uquery, &query, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/*Límites del cursor para la consulta por clave: solo la entrada más reciente de la clave entre las clases leídas
+*Se busca dentro de la lectura optimista, así una entrada desalojada durante la consulta repite la búsqueda
+*/
+static void key_bounds(const void *arg, struct read_cursor *cursor) {
+    const struct chardev_key_query *query = arg;
+    u64 seq = keyindex_find(query->key, query->key_len, cursor->mask);
+
+    cursor->seq = seq == KEY_NONE ? 0 : seq;
+    cursor->end = seq == KEY_NONE ? 0 : seq + 1;
+}
+
+/*Consulta por clave:
+*Copia al buffer de usuario la entrada más reciente de la clave, el filtro del descriptor no se aplica
+*Si la entrada no cabe retorna 0 con entries en 0, si la clave no tiene entradas retorna -ENOENT
+*/
+static long key_lookup(struct chardev_file *file, struct chardev_key_query __user *uquery) {
+    struct chardev_key_query query;
+    struct chardev_file lookup = *file;
+    long ret;
+
+    if (!keyindex_enabled()) {
+        return -EOPNOTSUPP;
+    }
+    if (copy_from_user(&query, uquery, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+    if (query.key_len == 0 || query.key_len > CHARDEV_KEY_MAX) {
+        return -EINVAL;
+    }
+
+    lookup.filter.type = CHARDEV_FILTER_NONE;
+    ret = copy_entries(&lookup, key_bounds, &query, query.buf, query.buf_len, &query.copied, &query.entries, NULL);
+    if (ret) {
+        return ret;
+    }
+    if (query.entries == 0 && keyindex_find(query.key, query.key_len, file->read_mask) == KEY_NONE) {
+        return -ENOENT;
+    }
+
+    /*Copia los contadores de salida al espacio usuario*/
+    if (copy_to_user(uquery, &query, sizeof(query)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/*Instala el filtro del descriptor:
+*Se valida antes de reemplazar el filtro actual, CHARDEV_FILTER_NONE lo desactiva
+*/
+static long set_filter(struct chardev_file *file, const struct chardev_filter __user *ufilter) {
+    struct chardev_filter filter;
+    int ret;
+
+    if (copy_from_user(&filter, ufilter, sizeof(filter)) != 0) {
+        return -EFAULT;
+    }
+    ret = filter_validate(&filter);
+    if (ret) {
+        return ret;
+    }
+    file->filter = filter;
+    return 0;
+}
+
+/*Configura el formato de lectura del descriptor, CHARDEV_FORMAT_TEXT o CHARDEV_FORMAT_BINARY
+*El cambio descarta una entrada leída parcialmente, sus bytes pendientes estaban en el formato anterior
+*/
+static long set_format(struct chardev_file *file, const __u32 __user *uformat) {
+    __u32 format;
+
+    if (get_user(format, uformat) != 0) {
+        return -EFAULT;
+    }
+    if (format != CHARDEV_FORMAT_TEXT && format != CHARDEV_FORMAT_BINARY) {
+        return -EINVAL;
+    }
+    file->format = format;
+    file->partial = 0;
+    return 0;
+}
+
+/*Configura las prioridades del descriptor:
+*write_prio debe ser una clase válida y read_mask debe seleccionar al menos una clase
+*/
+static long set_prio(struct chardev_file *file, const struct chardev_prio __user *uprio) {
+    struct chardev_prio prio;
+
+    if (copy_from_user(&prio, uprio, sizeof(prio)) != 0) {
+        return -EFAULT;
+    }
+    if (prio.write_prio >= CHARDEV_PRIO_COUNT || prio.read_mask == 0 || (prio.read_mask & ~CHARDEV_PRIO_ALL)) {
+        return -EINVAL;
+    }
+    file->write_prio = prio.write_prio;
+    file->read_mask = prio.read_mask;
+    return 0;
+}
+
+/*Registro de un eventfd para avisar de las entradas nuevas:
+*Las clases que se cuentan son las que lee el descriptor en ese momento (read_mask)
+*interval_us se limita a una hora para que la conversión a ns no se desborde
+*/
+static long set_notify(struct chardev_file *file, const struct chardev_notify __user *unotify) {
+    struct chardev_notify notify;
+
+    if (copy_from_user(&notify, unotify, sizeof(notify)) != 0) {
+        return -EFAULT;
+    }
+    if (notify.interval_us > 3600ULL * USEC_PER_SEC) {
+        return -EINVAL;
+    }
+    return notify_register(&file->notify, notify.fd, notify.every, notify.interval_us * NSEC_PER_USEC, file->read_mask);
+}
+
+/*Copia las estadísticas del buffer al espacio usuario, se toman juntas con el spinlock para que sean consistentes*/
+static long get_stats(struct chardev_stats __user *ustats) {
+    struct chardev_stats stats = {0};
+    unsigned long flags;
+    u64 key_bytes;
+    int p, cpu;
+
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    stats.entries = circ_buffer.count;
+    stats.next_seq = circ_buffer.next_seq;
+    stats.raw_bytes = circ_buffer.raw_bytes;
+    stats.stored_bytes = circ_buffer.stored_bytes;
+    stats.compressed_entries = circ_buffer.compressed;
+    stats.repeated = circ_buffer.repeated;
+    stats.entry_bytes = circ_buffer.entry_bytes;
+    stats.budget_bytes = READ_ONCE(max_bytes);
+    stats.budget_evicted = circ_buffer.budget_evicted;
+    stats.shrinker_freed = circ_buffer.shrinker_freed;
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        stats.prio_entries[p] = circ_buffer.rings[p].count;
+        stats.prio_capacity[p] = circ_buffer.rings[p].size;
+        stats.prio_evicted[p] = circ_buffer.rings[p].evicted;
+    }
+    keyindex_stats(&stats.keys, &key_bytes);
+    spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    stats.aux_bytes = aux_bytes() + key_bytes;
+    ratelimit_stats(&stats.rate_dropped, &stats.rate_rejected);
+    overload_stats(&stats.sampled, &stats.sample_ratio);
+    stats.netlink_dropped = netlink_dropped();
+
+    stats.numa_home_node = home_node;
+    for_each_possible_cpu(cpu) {
+        const struct numa_ops *ops = per_cpu_ptr(&numa_ops, cpu);
+
+        stats.local_writes += ops->local_writes;
+        stats.remote_writes += ops->remote_writes;
+        stats.local_reads += ops->local_reads;
+        stats.remote_reads += ops->remote_reads;
+    }
+
+    if (copy_to_user(ustats, &stats, sizeof(stats)) != 0) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/*Función de control del dispositivo:
+*cmd: comando ioctl definido en chardev_ioctl.h
+*arg: dirección en espacio usuario de la estructura del comando
+*Retorna -ENOTTY para comandos desconocidos
+*/
+long dev_ioctl(struct file *filep, unsigned int cmd, unsigned long arg) {
+    struct chardev_file *file = filep->private_data;
+
+    switch (cmd) {
+    case CHARDEV_IOC_TIME_RANGE:
+        return time_range_query(file, (struct chardev_time_query __user *)arg);
+    case CHARDEV_IOC_READ_RANGE:
+        return index_range_query(file, (struct chardev_range_query __user *)arg);
+    case CHARDEV_IOC_GET_STATS:
+        return get_stats((struct chardev_stats __user *)arg);
+    case CHARDEV_IOC_SET_FILTER:
+        return set_filter(file, (const struct chardev_filter __user *)arg);
+    case CHARDEV_IOC_SET_PRIO:
+        return set_prio(file, (const struct chardev_prio __user *)arg);
+    case CHARDEV_IOC_SET_FORMAT:
+        return set_format(file, (const __u32 __user *)arg);
+    case CHARDEV_IOC_PERSIST:
+        return persist_now();
+    case CHARDEV_IOC_SET_NOTIFY:
+        return set_notify(file, (const struct chardev_notify __user *)arg);
+    case CHARDEV_IOC_KEY_LOOKUP:
+        return key_lookup(file, (struct chardev_key_query __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
+/*Función para abrir el dispositivo:
+*Reserva el estado del descriptor (sin filtro, escribe con prioridad normal y lee todas las clases) y lo guarda en private_data
+*Registra en en logs del kernel que se abrió el dispositivo
+*/
+int dev_open(struct inode *inode, struct file *filep){
+	struct chardev_file *file = kzalloc(sizeof(*file), GFP_KERNEL);
+
+	if (!file) {
+		return -ENOMEM;
+	}
+	file->write_prio = CHARDEV_PRIO_NORMAL;
+	file->read_mask = CHARDEV_PRIO_ALL;
+	filep->private_data = file;
+#ifndef FOP_NOWAIT
+	filep->f_mode |= FMODE_NOWAIT;
+#endif
+	atomic_inc(&open_files);
+	printk(KERN_INFO "Modulo: Mayor: %i, Menor: %i\n", imajor(inode), iminor(inode));
+	return 0;
+}
+
+/*Función para cerrar el dispositivo:
+*Libera el estado del descriptor
+*Registra en logs del kernel que el archivo se cerró
+*/
+int dev_release(struct inode *inode, struct file *filep){
+	struct chardev_file *file = filep->private_data;
+
+	notify_unregister(&file->notify);
+	overload_reader_exit(&file->reader);
+	kfree(file);
+	atomic_dec(&open_files);
+	printk(KERN_INFO "Modulo: Archivo cerrado");
+	return 0;
+}
+
+/*Saca todas las entradas de una clase y las agrega a *list para liberarlas sin el spinlock, después reinicia sus índices
+*Debe llamarse con circ_buffer.lock tomado y dentro de write_seqcount_begin/end
+*/
+static void detach_ring(struct chardev_ring *ring, struct chardev_entry **list) {
+    while (ring->count > 0) {
+        struct chardev_entry *entry = evict_oldest(ring);
+
+        entry->next = *list;
+        *list = entry;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/*Saca todas las entradas de todas las clases y las retorna en una lista para liberarlas sin el spinlock:
+*Despues reinicia los índices, el contador y la contabilidad de bytes a 0
+*next_seq no se reinicia para que las posiciones de lectura sigan siendo válidas
+*Debe llamarse con circ_buffer.lock tomado
+*/
+static struct chardev_entry *detach_entries(void) {
+    struct chardev_entry *list = NULL;
+    int p;
+
+    write_seqcount_begin(&circ_buffer.seq);
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        detach_ring(&circ_buffer.rings[p], &list);
+    }
+    write_seqcount_end(&circ_buffer.seq);
+    return list;
+}
+
+/*Vacía todas las clases para CLEAR sin recorrer sus entradas, debe llamarse con circ_buffer.lock tomado:
+*Cada clase con un arreglo vacío en fresh[p] lo intercambia por el actual, que queda descrito en old[p] para liberarlo en segundo plano
+*Las clases sin arreglo nuevo (estaban vacías o no hubo memoria) sacan sus entradas a la lista que se retorna
+*Como todas las clases quedan vacías la contabilidad se reinicia a 0 sin restar entrada por entrada
+*/
+static struct chardev_entry *swap_rings(struct chardev_entry **fresh[], struct ring_graveyard *old[]) {
+    struct chardev_entry *list = NULL;
+    int p;
+
+    write_seqcount_begin(&circ_buffer.seq);
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        struct chardev_ring *ring = &circ_buffer.rings[p];
+
+        if (!fresh[p]) {
+            detach_ring(ring, &list);
+            continue;
+        }
+        old[p]->entries = ring->entries;
+        old[p]->size = ring->size;
+        old[p]->tail = ring->tail;
+        old[p]->count = ring->count;
+        WRITE_ONCE(ring->entries, fresh[p]);
+        ring->head = 0;
+        ring->tail = 0;
+        ring->count = 0;
+        ring->bytes = 0;
+        fresh[p] = NULL;
+    }
+    circ_buffer.count = 0;
+    circ_buffer.raw_bytes = 0;
+    circ_buffer.stored_bytes = 0;
+    circ_buffer.entry_bytes = 0;
+    circ_buffer.compressed = 0;
+    write_seqcount_end(&circ_buffer.seq);
+    return list;
+}
+
+/*Libera los arreglos que CLEAR dejó en graveyard y sus entradas, y las tablas anteriores del índice por clave:
+*Un lector optimista puede seguir recorriendo un arreglo anterior hasta salir de su sección de RCU, por eso se espera un periodo de gracia
+*Las listas se sacan antes de esperar, así todo lo que se libera se reemplazó antes del periodo de gracia
+*/
+static void reclaim_entries(struct work_struct *work) {
+    struct llist_node *list = llist_del_all(&graveyard);
+    struct llist_node *tables = keyindex_retired();
+    struct ring_graveyard *old, *tmp;
+
+    if (!list && !tables) {
+        return;
+    }
+    synchronize_rcu();
+    keyindex_release(tables);
+    llist_for_each_entry_safe(old, tmp, list, node) {
+        unsigned int i;
+
+        for (i = 0; i < old->count; i++) {
+            kvfree(old->entries[(old->tail + i) % old->size]);
+            cond_resched();
+        }
+        kvfree(old->entries);
+        kfree(old);
+    }
+}
+
+/*Cota del tamaño de la imagen de persistencia: encabezado, un registro por entrada y los mensajes con su relleno
+*Debe llamarse con circ_buffer.lock tomado
+*/
+static size_t snapshot_bound(void) {
+    return sizeof(struct persist_header) + circ_buffer.count * (sizeof(struct persist_record) + 7) + circ_buffer.raw_bytes;
+}
+
+/*Serializa en buf las entradas de todas las clases con número de secuencia menor a end, en orden:
+*Con el spinlock solo se toman los punteros de hasta PERSIST_BATCH entradas, la sección de RCU empieza antes de soltarlo
+*así las entradas no se liberan aunque se desalojen, y sus mensajes se copian sin el spinlock y con las interrupciones activas
+*Los mensajes comprimidos se guardan descomprimidos (con la preempción desactivada, usan el buffer del CPU actual),
+*así la imagen se puede cargar con o sin compress
+*La imagen no es una foto instantánea: una entrada desalojada antes de copiarse no se guarda. Las entradas nuevas
+*tienen número de secuencia mayor o igual a end y no entran, así buf con snapshot_bound() bytes tomados junto con end alcanza
+*Retorna el tamaño de la imagen
+*/
+static size_t snapshot_fill(char *buf, u64 end) {
+    struct persist_header *header = (struct persist_header *)buf;
+    struct chardev_entry *batch[PERSIST_BATCH];
+    size_t size = sizeof(*header);
+    unsigned long flags;
+    u64 seq = 0;
+    u32 count = 0;
+
+    for (;;) {
+        struct chardev_entry *entry;
+        unsigned int n = 0, i;
+
+        spin_lock_irqsave(&circ_buffer.lock, flags);
+        for (entry = next_entry(seq, CHARDEV_PRIO_ALL, NULL); entry && entry->seq < end && n < PERSIST_BATCH;
+             entry = next_entry(entry->seq + 1, CHARDEV_PRIO_ALL, NULL)) {
+            batch[n++] = entry;
+        }
+        rcu_read_lock();
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+
+        for (i = 0; i < n; i++) {
+            struct persist_record *record = (struct persist_record *)(buf + size);
+            const char *data;
+
+            entry = batch[i];
+            preempt_disable();
+            data = entry_data(entry);
+            if (data) {
+                memset(record, 0, sizeof(*record));
+                record->seq = entry->seq;
+                record->timestamp = entry->timestamp;
+                record->hash = entry->hash;
+                record->len = entry->len;
+                record->repeat = READ_ONCE(entry->repeat);
+                record->weight = entry->weight;
+                record->prio = entry->prio;
+                record->flags = (entry->flags & ENTRY_HASHED) ? PERSIST_HASHED : 0;
+                memcpy(record + 1, data, entry->len);
+                memset((char *)(record + 1) + entry->len, 0, PERSIST_RECORD_SIZE(entry->len) - sizeof(*record) - entry->len);
+                size += PERSIST_RECORD_SIZE(entry->len);
+                count++;
+            }
+            preempt_enable();
+        }
+        rcu_read_unlock();
+        if (n < PERSIST_BATCH) {
+            break;
+        }
+        seq = batch[n - 1]->seq + 1;
+        cond_resched();
+    }
+    header->magic = PERSIST_MAGIC;
+    header->version = PERSIST_VERSION;
+    header->count = count;
+    header->next_seq = end;
+    header->size = size;
+    return size;
+}
+
+/*Guarda las entradas en persist_path:
+*Con el spinlock solo se toman el tamaño máximo de la imagen y el número de secuencia donde termina,
+*la imagen se arma por partes (snapshot_fill) y se escribe al archivo en una sola escritura
+*Retorna -EINVAL si no se configuró persist_path
+*/
+static int save_chardev(void) {
+    unsigned long flags;
+    size_t bound, size;
+    u64 end;
+    char *image;
+    int ret;
+
+    if (!persist_path || !*persist_path) {
+        return -EINVAL;
+    }
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    bound = snapshot_bound();
+    end = circ_buffer.next_seq;
+    spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    if (bound > PERSIST_MAX_SIZE) {
+        return -EFBIG;
+    }
+
+    image = kvmalloc(bound, GFP_KERNEL);
+    if (!image) {
+        return -ENOMEM;
+    }
+    size = snapshot_fill(image, end);
+
+    ret = persist_write(persist_path, image, size);
+    kvfree(image);
+    if (ret) {
+        printk(KERN_WARNING "Modulo: No se logro guardar el buffer en %s (%i)\n", persist_path, ret);
+    } else {
+        printk(KERN_INFO "Modulo: Buffer guardado en %s (%zu bytes)\n", persist_path, size);
+    }
+    return ret;
+}
+
+/*Timestamp más reciente de los registros de una imagen, recorre los registros hasta el primero inválido*/
+static u64 image_newest(const char *image, const struct persist_header *header) {
+    size_t offset = sizeof(*header);
+    u64 newest = 0;
+    u32 i;
+
+    for (i = 0; i < header->count; i++) {
+        const struct persist_record *record = (const struct persist_record *)(image + offset);
+
+        if (offset + sizeof(*record) > header->size || record->len == 0 || record->len > LARGE_ENTRY_LIMIT ||
+            offset + PERSIST_RECORD_SIZE(record->len) > header->size) {
+            break;
+        }
+        newest = max(newest, record->timestamp);
+        offset += PERSIST_RECORD_SIZE(record->len);
+    }
+    return newest;
+}
+
+/*Restaura las entradas de persist_path al cargar el módulo:
+*El archivo se lee completo en una sola lectura y se valida el encabezado, un registro inválido detiene la carga
+*Cada entrada vuelve a su clase con su número de secuencia, y se comprime otra vez si compress está activo
+*Si la capacidad de una clase es menor que antes se conservan sus entradas más recientes, las demás cuentan como desalojadas
+*Timestamps: el reloj monotónico vuelve a empezar en cada arranque, así que una imagen de un arranque anterior puede tener
+*timestamps mayores que las escrituras nuevas. Si el más reciente de la imagen es mayor que ktime_get_ns() todos se recorren
+*hacia atrás (shift) para que el más reciente quede en el momento de la carga, y cada uno se lleva al menos al anterior,
+*así las búsquedas por tiempo (find_by_time) siguen viendo cada clase ordenada
+*/
+static void restore_chardev(void) {
+    const struct persist_header *header;
+    unsigned long flags;
+    size_t size, offset;
+    u64 next_seq = 0, now, newest, shift, prev_ts = 0;
+    u32 i, restored = 0;
+    char *image;
+
+    if (!persist_path || !*persist_path) {
+        return;
+    }
+    image = persist_read(persist_path, &size);
+    if (IS_ERR(image)) {
+        if (PTR_ERR(image) != -ENOENT) {
+            printk(KERN_WARNING "Modulo: No se logro leer %s (%li)\n", persist_path, PTR_ERR(image));
+        }
+        return;
+    }
+
+    header = (const struct persist_header *)image;
+    if (size < sizeof(*header) || header->magic != PERSIST_MAGIC || header->version != PERSIST_VERSION ||
+        header->size > size) {
+        printk(KERN_WARNING "Modulo: %s no es una imagen valida del buffer\n", persist_path);
+        kvfree(image);
+        return;
+    }
+
+    now = ktime_get_ns();
+    newest = image_newest(image, header);
+    shift = newest > now ? newest - now : 0;
+
+    offset = sizeof(*header);
+    for (i = 0; i < header->count; i++) {
+        const struct persist_record *record = (const struct persist_record *)(image + offset);
+        struct chardev_entry *entry, *stored, *evicted = NULL;
+        struct chardev_ring *ring;
+        struct key_node *spare;
+        int key_len;
+
+        if (offset + sizeof(*record) > header->size || record->len == 0 || record->len > LARGE_ENTRY_LIMIT ||
+            offset + PERSIST_RECORD_SIZE(record->len) > header->size || record->prio >= CHARDEV_PRIO_COUNT ||
+            record->seq < next_seq) {
+            printk(KERN_WARNING "Modulo: Registro %u invalido en %s\n", i, persist_path);
+            break;
+        }
+        entry = alloc_entry(record->len + 1, GFP_KERNEL);
+        if (!entry) {
+            break;
+        }
+        memcpy(entry->data, record + 1, record->len);
+        entry->data[record->len] = '\0';
+        prev_ts = max(prev_ts, record->timestamp);
+        entry->seq = record->seq;
+        entry->timestamp = prev_ts - min(prev_ts, shift);
+        entry->len = record->len;
+        entry->stored_len = record->len;
+        entry->prio = record->prio;
+        entry->flags = (record->flags & PERSIST_HASHED) ? ENTRY_HASHED : 0;
+        entry->repeat = record->repeat;
+        entry->weight = record->weight ? record->weight : record->repeat + 1;
+        entry->hash = record->hash;
+        key_len = key_entry(entry, &spare, GFP_KERNEL);
+        if (key_len < 0) {
+            kvfree(entry);
+            break;
+        }
+
+        stored = pack_entry(entry, false);
+        if (stored != entry) {
+            stored->seq = entry->seq;
+            stored->timestamp = entry->timestamp;
+            stored->repeat = entry->repeat;
+        }
+
+        spin_lock_irqsave(&circ_buffer.lock, flags);
+        ring = &circ_buffer.rings[stored->prio];
+        write_seqcount_begin(&circ_buffer.seq);
+        if (key_len > 0) {
+            keyindex_set(entry->data, key_len, stored->key_hash, stored->prio, stored->seq, &spare);
+        }
+        if (ring->count == ring->size) {
+            evicted = evict_oldest(ring);
+            ring->evicted++;
+        }
+        ring_push(ring, stored);
+        write_seqcount_end(&circ_buffer.seq);
+        spin_unlock_irqrestore(&circ_buffer.lock, flags);
+        kvfree(evicted);
+        keyindex_put(spare);
+        if (stored != entry) {
+            kvfree(entry);
+        }
+
+        next_seq = record->seq + 1;
+        offset += PERSIST_RECORD_SIZE(record->len);
+        restored++;
+    }
+
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    write_seqcount_begin(&circ_buffer.seq);
+    circ_buffer.next_seq = max(header->next_seq, next_seq);
+    write_seqcount_end(&circ_buffer.seq);
+    spin_unlock_irqrestore(&circ_buffer.lock, flags);
+    printk(KERN_INFO "Modulo: %u entradas restauradas desde %s\n", restored, persist_path);
+    kvfree(image);
+}
+
+/*Guarda la imagen del buffer por ioctl, requiere CAP_SYS_ADMIN porque escribe un archivo del sistema*/
+static long persist_now(void) {
+    if (!capable(CAP_SYS_ADMIN)) {
+        return -EPERM;
+    }
+    return save_chardev();
+}
+
+/*Función para limpiar el buffer:
+*Los arreglos nuevos se reservan antes de tomar el spinlock, así con el spinlock tomado solo se intercambian punteros (O(1))
+*y las entradas anteriores se liberan en segundo plano, un buffer de millones de entradas no detiene a los escritores
+*/
+void clear_chardev(void) {
+    /*Protección de buffer circular: 
+    *flags: variable para almacenar el estado de las interrupciones
+    *spin_lock_irqsave: bloquea el acceso al buffer y deshabilita interrupciones 
+    *Almacena el estado de las interrupciones en flags para restaurarlo después
+    *fresh, old: arreglo vacío y descripción del arreglo anterior de cada clase con entradas
+    *fresh_keys, old_keys: tabla vacía del índice por clave y la anterior (sin tabla nueva la actual se vacía con el spinlock tomado)
+    */
+    unsigned long flags;
+    struct chardev_entry *detached;
+    struct chardev_entry **fresh[CHARDEV_PRIO_COUNT] = { NULL };
+    struct ring_graveyard *old[CHARDEV_PRIO_COUNT] = { NULL };
+    struct key_table *fresh_keys = keyindex_table(), *old_keys;
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        if (READ_ONCE(circ_buffer.rings[p].count) == 0) {
+            continue;
+        }
+        old[p] = kmalloc(sizeof(*old[p]), GFP_KERNEL);
+        fresh[p] = ring_array(circ_buffer.rings[p].size, sizeof(*fresh[p]));
+        if (!old[p] || !fresh[p]) {
+            kfree(old[p]);
+            kvfree(fresh[p]);
+            old[p] = NULL;
+            fresh[p] = NULL;
+        }
+    }
+
+    spin_lock_irqsave(&circ_buffer.lock, flags);
+    detached = swap_rings(fresh, old);
+    old_keys = keyindex_swap(fresh_keys);
+    //Restarua el estado de interrupciones
+    spin_unlock_irqrestore(&circ_buffer.lock, flags);
+
+    /*Libera las entradas fuera del spinlock, kvfree puede dormir*/
+    free_entries(detached);
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        if (old[p] && !fresh[p]) {
+            llist_add(&old[p]->node, &graveyard);
+        } else {
+            kfree(old[p]);
+            kvfree(fresh[p]);
+        }
+    }
+    if (old_keys) {
+        keyindex_retire(old_keys);
+    }
+    schedule_work(&reclaim_work);
     printk(KERN_INFO "Modulo: Buffer limpiado completamente\n");
 }
 
+/*Pruebas de KUnit (make modulo KUNIT=1): se incluyen aquí para usar las funciones y el estado estáticos del buffer*/
+#if defined(CHARDEV_KUNIT) && IS_ENABLED(CONFIG_KUNIT)
+#include "chardev_test.c"
+#endif
@@ -2,13 +2,25 @@
 *Se definen constantes de configuración y funciones
 *DEVICE_NAME: define nombre del dispositivo que aparecerá en /dev y /proc/devices
 *ENTRY_SIZE: define el tamaño máximo en bytes para cada entrada del buffer 
-*MAX_ENTRIES: define la capacidad máxima de mensjaes en el buffer circular
+*MAX_ENTRIES: define la capacidad por defecto de mensjaes en el buffer circular de cada clase de prioridad
+*RING_MAX_ENTRIES: capacidad máxima del buffer de una clase (parámetro ring_entries), el arreglo de punteros ocupa 8 bytes por entrada
+*LARGE_ENTRY_LIMIT: límite absoluto en bytes para una entrada grande (el parámetro max_entry_size no puede superarlo)
+*READ_BUFFER_SIZE: tamaño del buffer temporal de las lecturas, las entradas más grandes se entregan en varias partes
+*READ_RETRIES: intentos de lseek sin spinlock antes de tomarlo, si los escritores cambian el buffer en cada intento
+*READ_SCAN_ENTRIES: entradas que revisa una lectura (copiadas o descartadas por el filtro) antes de habilitar la expropiación
+*PERSIST_BATCH: entradas que se toman del buffer en cada paso al guardarlo, sus mensajes se copian sin el spinlock
  */
 #ifndef CHARDEV_H
 #define CHARDEV_H
 #define DEVICE_NAME "chardev" 
 #define ENTRY_SIZE 128 
 #define MAX_ENTRIES 10
+#define RING_MAX_ENTRIES (16 * 1024 * 1024)
+#define LARGE_ENTRY_LIMIT (4 * 1024 * 1024)
+#define READ_BUFFER_SIZE (16 * PAGE_SIZE)
+#define READ_RETRIES 4
+#define READ_SCAN_ENTRIES 1024
+#define PERSIST_BATCH 64
 
 //Función para inicializar y registrar el dispositivo 
 int init_chardev(void);
@@ -19,11 +31,20 @@ void cleanup_chardev(void);
 //Función para limpiar todas las entradas del dispositivo
 void clear_chardev(void); 
 
-//Funcion para leer el dispositivo
-ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *offset);
+//Funcion para leer el dispositivo (read, readv e io_uring), con IOCB_NOWAIT no bloquea
+ssize_t dev_read_iter(struct kiocb *iocb, struct iov_iter *to);
 
-//Funcion para escribir en el dispositivo
-ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset);
+//Funcion para mover la posicion de lectura (numero de secuencia de una entrada)
+loff_t dev_llseek(struct file *filep, loff_t offset, int whence);
+
+//Funcion para escribir en el dispositivo (write, writev e io_uring), con IOCB_NOWAIT retorna -EAGAIN en lugar de bloquear
+ssize_t dev_write_iter(struct kiocb *iocb, struct iov_iter *from);
+
+//Funcion para avisar si hay entradas por leer (poll, epoll, io_uring)
+__poll_t dev_poll(struct file *filep, struct poll_table_struct *wait);
+
+//Funcion para los comandos de control (ioctl) del dispositivo
+long dev_ioctl(struct file *filep, unsigned int cmd, unsigned long arg);
 
 //Funcion para abrir el dispositivo
 int dev_open(struct inode *inode, struct file *filep);
@@ -0,0 +1,256 @@
+/*Header CHARDEV_IOCTL_H con la interfaz de control (ioctl) del char device
+*Se comparte entre el módulo del kernel y el programa de userspace (cli.c), por eso solo usa tipos de <linux/types.h>
+*CHARDEV_IOC_MAGIC: número mágico que identifica los comandos ioctl del dispositivo
+*/
+#ifndef CHARDEV_IOCTL_H
+#define CHARDEV_IOCTL_H
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define CHARDEV_IOC_MAGIC 'c'
+
+/*Clases de prioridad, cada una tiene su propio buffer circular y capacidad:
+*CHARDEV_PRIO_LOW: mensajes de depuración, son los primeros en desalojarse
+*CHARDEV_PRIO_NORMAL: prioridad por defecto de las escrituras
+*CHARDEV_PRIO_CRITICAL: mensajes críticos, una ráfaga de mensajes de menor prioridad no los desaloja
+*CHARDEV_PRIO_MASK(p): bit de la clase p en una máscara de lectura, CHARDEV_PRIO_ALL selecciona todas
+*CHARDEV_PRIO_TAG(p): byte que puede ir al inicio de un mensaje para escribirlo con prioridad p, el byte no se guarda
+*/
+#define CHARDEV_PRIO_LOW 0
+#define CHARDEV_PRIO_NORMAL 1
+#define CHARDEV_PRIO_CRITICAL 2
+#define CHARDEV_PRIO_COUNT 3
+#define CHARDEV_PRIO_MASK(p) (1U << (p))
+#define CHARDEV_PRIO_ALL ((1U << CHARDEV_PRIO_COUNT) - 1)
+#define CHARDEV_PRIO_TAG_BASE 0x01
+#define CHARDEV_PRIO_TAG(p) (CHARDEV_PRIO_TAG_BASE + (p))
+
+/*Consulta de entradas por rango de tiempo:
+*from_ns, to_ns: límites inclusivos en nanosegundos del reloj monotónico (ktime_get_ns, CLOCK_MONOTONIC en userspace)
+*buf: dirección del buffer de usuario donde se copian las entradas
+*buf_len: tamaño del buffer de usuario
+*copied: (salida) bytes copiados en buf
+*entries: (salida) número de entradas copiadas, solo se copian entradas completas
+*flags: (salida) CHARDEV_QUERY_TRUNCATED si quedaron entradas del rango sin copiar porque no cabían en buf_len,
+*el usuario repite la consulta con un buffer más grande
+*Si la primera entrada del rango no cabe en buf_len la consulta falla con EMSGSIZE, así se distingue de un rango vacío
+*/
+#define CHARDEV_QUERY_TRUNCATED 0x1
+
+struct chardev_time_query {
+    __u64 from_ns;
+    __u64 to_ns;
+    __u64 buf;
+    __u64 buf_len;
+    __u64 copied;
+    __u32 entries;
+    __u32 flags;
+};
+
+#define CHARDEV_IOC_TIME_RANGE _IOWR(CHARDEV_IOC_MAGIC, 1, struct chardev_time_query)
+
+/*Consulta de entradas por rango de índices:
+*first: índice de la primera entrada, 0 es la más antigua. Un valor negativo cuenta desde la más reciente (-1 es la última)
+*count: número máximo de entradas a partir de first
+*buf, buf_len, copied, entries, flags: igual que en chardev_time_query, también falla con EMSGSIZE si la primera entrada no cabe
+*y marca con CHARDEV_QUERY_TRUNCATED una respuesta que no alcanzó a copiar todas las entradas del rango
+*/
+struct chardev_range_query {
+    __s64 first;
+    __u32 count;
+    __u32 entries;
+    __u64 buf;
+    __u64 buf_len;
+    __u64 copied;
+    __u32 flags;
+    __u32 reserved;
+};
+
+#define CHARDEV_IOC_READ_RANGE _IOWR(CHARDEV_IOC_MAGIC, 3, struct chardev_range_query)
+
+/*Estadísticas del buffer:
+*entries: número de entradas actuales en el buffer
+*next_seq: número de secuencia de la próxima entrada (total de entradas escritas desde que se cargó el módulo)
+*raw_bytes: bytes originales de las entradas actuales
+*stored_bytes: bytes guardados de las entradas actuales, raw_bytes / stored_bytes es la tasa de compresión
+*compressed_entries: entradas actuales guardadas comprimidas con LZ4
+*repeated: escrituras agrupadas con la entrada más reciente por ser mensajes repetidos (dedup)
+*entry_bytes: memoria que ocupan las entradas actuales (incluye encabezados y redondeo de las asignaciones)
+*aux_bytes: memoria auxiliar del módulo (buffers de compresión, estado de los descriptores)
+*budget_bytes: presupuesto de memoria para las entradas (parámetro max_bytes, 0 sin límite)
+*budget_evicted: entradas desalojadas para respetar el presupuesto
+*shrinker_freed: entradas liberadas por el shrinker cuando el sistema necesitó memoria
+*prio_entries, prio_capacity, prio_evicted: entradas actuales, capacidad y entradas desalojadas de cada clase de prioridad
+*rate_dropped, rate_rejected: escrituras descartadas y rechazadas (-EAGAIN) por el límite de tasa
+*numa_home_node: nodo NUMA del buffer (spinlock y arreglos de las clases)
+*local_writes, remote_writes: escrituras desde un CPU del nodo del buffer y desde otro nodo
+*local_reads, remote_reads: entradas leídas por un CPU del nodo donde está la entrada y de otro nodo
+*keys: claves en el índice de entradas por clave (parámetro keyed)
+*sampled: escrituras descartadas por el muestreo en sobrecarga (parámetro overload), aceptadas pero no guardadas
+*sample_ratio: tasa actual del muestreo, se guarda 1 de cada sample_ratio escrituras (1 fuera de sobrecarga)
+*netlink_dropped: entradas que no se publicaron por netlink (parámetro netlink) porque no hubo memoria para su mensaje
+*/
+struct chardev_stats {
+    __u64 entries;
+    __u64 next_seq;
+    __u64 raw_bytes;
+    __u64 stored_bytes;
+    __u64 compressed_entries;
+    __u64 repeated;
+    __u64 entry_bytes;
+    __u64 aux_bytes;
+    __u64 budget_bytes;
+    __u64 budget_evicted;
+    __u64 shrinker_freed;
+    __u64 prio_entries[CHARDEV_PRIO_COUNT];
+    __u64 prio_capacity[CHARDEV_PRIO_COUNT];
+    __u64 prio_evicted[CHARDEV_PRIO_COUNT];
+    __u64 rate_dropped;
+    __u64 rate_rejected;
+    __s64 numa_home_node;
+    __u64 local_writes;
+    __u64 remote_writes;
+    __u64 local_reads;
+    __u64 remote_reads;
+    __u64 keys;
+    __u64 sampled;
+    __u64 sample_ratio;
+    __u64 netlink_dropped;
+};
+
+#define CHARDEV_IOC_GET_STATS _IOR(CHARDEV_IOC_MAGIC, 4, struct chardev_stats)
+
+/*Tipos de filtro para las lecturas:
+*CHARDEV_FILTER_NONE: sin filtro, se leen todas las entradas
+*CHARDEV_FILTER_PREFIX: la entrada empieza con pattern
+*CHARDEV_FILTER_SUBSTR: la entrada contiene pattern en cualquier posición
+*CHARDEV_FILTER_TAG: el byte en la posición tag_offset de la entrada es igual a tag
+*/
+#define CHARDEV_FILTER_NONE 0
+#define CHARDEV_FILTER_PREFIX 1
+#define CHARDEV_FILTER_SUBSTR 2
+#define CHARDEV_FILTER_TAG 3
+#define CHARDEV_FILTER_MAX_PATTERN 64
+
+/*Filtro por descriptor de archivo, se aplica en el módulo antes de copiar las entradas al usuario:
+*type: uno de los tipos CHARDEV_FILTER_*
+*len: longitud de pattern en bytes (PREFIX y SUBSTR)
+*tag_offset, tag: posición y valor del byte a comparar (TAG)
+*pattern: patrón a buscar, no necesita terminador nulo
+*/
+struct chardev_filter {
+    __u32 type;
+    __u32 len;
+    __u32 tag_offset;
+    __u8 tag;
+    __u8 reserved[3];
+    char pattern[CHARDEV_FILTER_MAX_PATTERN];
+};
+
+#define CHARDEV_IOC_SET_FILTER _IOW(CHARDEV_IOC_MAGIC, 2, struct chardev_filter)
+
+/*Prioridades por descriptor de archivo:
+*write_prio: clase de las escrituras sin byte de prioridad (por defecto CHARDEV_PRIO_NORMAL)
+*read_mask: clases que se leen (por defecto CHARDEV_PRIO_ALL), las entradas de varias clases se entregan en orden de escritura
+*/
+struct chardev_prio {
+    __u32 write_prio;
+    __u32 read_mask;
+};
+
+#define CHARDEV_IOC_SET_PRIO _IOW(CHARDEV_IOC_MAGIC, 5, struct chardev_prio)
+
+/*Formatos de lectura y escritura por descriptor de archivo:
+*CHARDEV_FORMAT_TEXT: los mensajes se entregan concatenados como texto (por defecto), las repeticiones se anuncian con una línea de aviso.
+*Cada escritura es una entrada
+*CHARDEV_FORMAT_BINARY: cada entrada se entrega como un chardev_record seguido del mensaje, relleno con ceros hasta múltiplo de 8 bytes.
+*Una escritura puede llevar varios registros con el mismo formato (solo se usan len y prio), cada uno se guarda como una entrada
+*/
+#define CHARDEV_FORMAT_TEXT 0
+#define CHARDEV_FORMAT_BINARY 1
+
+/*Encabezado de una entrada en el formato binario:
+*len: longitud del mensaje que sigue al encabezado (sin relleno)
+*repeat: veces que el mensaje se repitió después de guardarse (dedup)
+*seq: número de secuencia de la entrada
+*timestamp: marca de tiempo en ns del reloj monotónico
+*prio: clase de prioridad (CHARDEV_PRIO_*)
+*flags: CHARDEV_RECORD_COMPRESSED si el módulo guarda la entrada comprimida (el mensaje se entrega descomprimido)
+*weight: escrituras que representa la entrada contando sus repeticiones (repeat + 1 sin sobrecarga). En sobrecarga
+*(parámetro overload) cada escritura guardada o agrupada suma la tasa del muestreo. Un valor de 0 (módulos anteriores)
+*equivale a repeat + 1. Para estimar las escrituras reales se suman los pesos
+*CHARDEV_RECORD_SIZE(len): bytes que ocupa el registro completo, la siguiente entrada empieza justo después.
+*Se calcula en 64 bits para que un len cercano a 2^32 no dé la vuelta a un tamaño pequeño
+*/
+#define CHARDEV_RECORD_COMPRESSED 0x1
+#define CHARDEV_RECORD_ALIGN 8
+#define CHARDEV_RECORD_SIZE(len) (sizeof(struct chardev_record) + \
+                                  (((__u64)(len) + CHARDEV_RECORD_ALIGN - 1) & ~(__u64)(CHARDEV_RECORD_ALIGN - 1)))
+
+struct chardev_record {
+    __u32 len;
+    __u32 repeat;
+    __u64 seq;
+    __u64 timestamp;
+    __u8 prio;
+    __u8 flags;
+    __u16 reserved;
+    __u32 weight;
+};
+
+#define CHARDEV_IOC_SET_FORMAT _IOW(CHARDEV_IOC_MAGIC, 7, __u32)
+
+/*Guarda las entradas en el archivo del parámetro persist_path del módulo (requiere CAP_SYS_ADMIN)*/
+#define CHARDEV_IOC_PERSIST _IO(CHARDEV_IOC_MAGIC, 6)
+
+/*Aviso de entradas nuevas por eventfd:
+*fd: eventfd que el módulo incrementa, -1 quita el registro del descriptor
+*every: se avisa cada every entradas nuevas (0 solo por tiempo)
+*interval_us: se avisa como máximo interval_us microsegundos después de la primera entrada sin avisar (0 solo por número)
+*Con ambos en 0 se avisa por cada entrada. Solo cuentan las entradas de las clases que lee el descriptor al registrar
+*Cada aviso suma 1 al contador del eventfd, al despertar se lee el dispositivo hasta el final
+*/
+struct chardev_notify {
+    __s32 fd;
+    __u32 every;
+    __u64 interval_us;
+};
+
+#define CHARDEV_IOC_SET_NOTIFY _IOW(CHARDEV_IOC_MAGIC, 8, struct chardev_notify)
+
+/*Entradas por clave (parámetro keyed del módulo):
+*CHARDEV_KEY_DELIM: un mensaje "clave=valor" se indexa por los bytes antes del primer CHARDEV_KEY_DELIM
+*CHARDEV_KEY_MAX: longitud máxima de una clave, los mensajes con una clave vacía o más larga no se indexan
+*/
+#define CHARDEV_KEY_DELIM '='
+#define CHARDEV_KEY_MAX 64
+
+/*Consulta de la entrada más reciente de una clave:
+*key_len, key: clave a buscar (sin terminador nulo)
+*entries: (salida) 1 si la entrada se copió, 0 si no cabe en buf
+*buf, buf_len, copied: igual que en chardev_time_query, la entrada se copia completa en el formato del descriptor
+*Solo se buscan las clases que lee el descriptor y el filtro no se aplica. Retorna ENOENT si la clave no tiene entradas
+*/
+struct chardev_key_query {
+    __u32 key_len;
+    __u32 entries;
+    char key[CHARDEV_KEY_MAX];
+    __u64 buf;
+    __u64 buf_len;
+    __u64 copied;
+};
+
+#define CHARDEV_IOC_KEY_LOOKUP _IOWR(CHARDEV_IOC_MAGIC, 9, struct chardev_key_query)
+
+/*Publicación de las entradas nuevas por generic netlink (parámetro netlink del módulo):
+*CHARDEV_NL_FAMILY, CHARDEV_NL_GROUP: nombre de la familia y de su grupo multicast, el id de cada uno se resuelve con el controlador de genetlink
+*CHARDEV_NL_CMD_ENTRIES: comando de los mensajes del grupo, cada mensaje lleva un lote de entradas
+*CHARDEV_NL_A_RECORD: atributo con una entrada, un chardev_record seguido del mensaje (sin relleno), se repite una vez por entrada
+*/
+#define CHARDEV_NL_FAMILY "chardev"
+#define CHARDEV_NL_GROUP "entries"
+#define CHARDEV_NL_VERSION 1
+#define CHARDEV_NL_CMD_ENTRIES 1
+#define CHARDEV_NL_A_RECORD 1
+
+#endif
@@ -0,0 +1,590 @@
+/*Pruebas de KUnit del buffer circular:
+*Se compilan dentro de chardev.c (make modulo KUNIT=1) para llegar a las funciones y al estado estáticos del buffer,
+*y se ejecutan al cargar el módulo con los parámetros por defecto. Cada prueba empieza y termina con el buffer vacío (CLEAR)
+*Headers:
+*include <kunit/test.h>: framework de pruebas KUnit, los resultados salen en dmesg en formato KTAP (kunit.py parse)
+*include <linux/kthread.h>, <linux/completion.h>: escritores y lectores concurrentes de la prueba de concurrencia
+*/
+#include <kunit/test.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+
+/*Parámetros de las pruebas:
+*TEST_MESSAGE: tamaño máximo de los mensajes que se escriben y se decodifican
+*TEST_READ_SIZE: tamaño del buffer de cada lectura, cabe un READ_BUFFER_SIZE completo
+*TEST_THREADS, TEST_THREAD_WRITES: escritores concurrentes y mensajes que escribe cada uno
+*TEST_READER_RECORDS: registros que caben como máximo en cada lectura del lector concurrente
+*/
+#define TEST_MESSAGE 64
+#define TEST_READ_SIZE READ_BUFFER_SIZE
+#define TEST_THREADS 4
+#define TEST_THREAD_WRITES 2000
+#define TEST_READER_RECORDS 128
+
+/*Descriptor de prueba, un struct file con el estado del descriptor igual al que deja dev_open:*/
+struct test_file {
+    struct file filp;
+    struct chardev_file file;
+};
+
+/*Registro decodificado de una lectura binaria:*/
+struct test_record {
+    struct chardev_record head;
+    char msg[TEST_MESSAGE];
+};
+
+/*Estado de la suite: capacidad original de las clases y parámetros que las pruebas desactivan*/
+static unsigned int test_ring_entries[CHARDEV_PRIO_COUNT];
+static bool test_dedup;
+static unsigned long test_max_bytes;
+
+//Quita el descriptor de la lista de lectores de la sobrecarga al terminar la prueba
+static void test_close(void *reader) {
+    overload_reader_exit(reader);
+}
+
+static struct test_file *test_open(struct kunit *test, unsigned int format) {
+    struct test_file *tf = kunit_kzalloc(test, sizeof(*tf), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, tf);
+    tf->file.write_prio = CHARDEV_PRIO_NORMAL;
+    tf->file.read_mask = CHARDEV_PRIO_ALL;
+    tf->file.format = format;
+    tf->filp.private_data = &tf->file;
+    //Al leer el descriptor se registra como lector de la sobrecarga, se quita en test_close
+    KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, test_close, &tf->file.reader), 0);
+    return tf;
+}
+
+//Escribe un buffer con dev_write_iter, como write(2)
+static ssize_t test_write(struct test_file *tf, const void *buf, size_t len) {
+    struct kvec vec = { .iov_base = (void *)buf, .iov_len = len };
+    struct iov_iter iter;
+    struct kiocb kiocb;
+
+    init_sync_kiocb(&kiocb, &tf->filp);
+    iov_iter_kvec(&iter, ITER_SOURCE, &vec, 1, len);
+    return dev_write_iter(&kiocb, &iter);
+}
+
+//Lee desde la posición del descriptor con dev_read_iter y la avanza, como read(2)
+static ssize_t test_read(struct test_file *tf, void *buf, size_t len) {
+    struct kvec vec = { .iov_base = buf, .iov_len = len };
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    ssize_t ret;
+
+    init_sync_kiocb(&kiocb, &tf->filp);
+    kiocb.ki_pos = tf->filp.f_pos;
+    iov_iter_kvec(&iter, ITER_DEST, &vec, 1, len);
+    ret = dev_read_iter(&kiocb, &iter);
+    if (ret >= 0) {
+        tf->filp.f_pos = kiocb.ki_pos;
+    }
+    return ret;
+}
+
+//Escribe un mensaje de texto con la etiqueta de prioridad p (p negativo: sin etiqueta, clase del descriptor)
+static void test_message(struct kunit *test, struct test_file *tf, int p, const char *fmt, unsigned int n) {
+    char msg[TEST_MESSAGE];
+    int len = 0;
+
+    if (p >= 0) {
+        msg[len++] = CHARDEV_PRIO_TAG(p);
+    }
+    len += snprintf(msg + len, sizeof(msg) - len, fmt, n);
+    KUNIT_ASSERT_EQ(test, test_write(tf, msg, len), (ssize_t)len);
+}
+
+/*Decodifica un bloque de registros binarios:
+*Verifica que cada registro ocupe CHARDEV_RECORD_SIZE(len) bytes con el relleno en cero y que el bloque termine en un registro
+*Devuelve el número de registros decodificados, o -1 si el bloque no está bien formado
+*/
+static int test_decode(const char *buf, size_t size, struct test_record *records, int max) {
+    size_t off = 0;
+    int n = 0;
+
+    while (off < size) {
+        struct test_record *record = &records[n];
+        size_t rsize, pad;
+
+        if (n == max || size - off < sizeof(record->head)) {
+            return -1;
+        }
+        memcpy(&record->head, buf + off, sizeof(record->head));
+        rsize = CHARDEV_RECORD_SIZE(record->head.len);
+        if (record->head.len == 0 || record->head.len >= TEST_MESSAGE || rsize > size - off) {
+            return -1;
+        }
+        memcpy(record->msg, buf + off + sizeof(record->head), record->head.len);
+        record->msg[record->head.len] = '\0';
+        for (pad = sizeof(record->head) + record->head.len; pad < rsize; pad++) {
+            if (buf[off + pad]) {
+                return -1;
+            }
+        }
+        off += rsize;
+        n++;
+    }
+    return n;
+}
+
+//Lee en formato binario todo lo que queda desde la posición del descriptor y lo decodifica en records
+static int test_records(struct kunit *test, struct test_file *tf, struct test_record *records, int max) {
+    char *buf = kunit_kmalloc(test, TEST_READ_SIZE, GFP_KERNEL);
+    int n = 0;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    tf->file.format = CHARDEV_FORMAT_BINARY;
+    for (;;) {
+        ssize_t ret = test_read(tf, buf, TEST_READ_SIZE);
+        int got;
+
+        KUNIT_ASSERT_GE(test, ret, 0);
+        if (ret == 0) {
+            break;
+        }
+        got = test_decode(buf, ret, records + n, max - n);
+        KUNIT_ASSERT_GE_MSG(test, got, 0, "registros mal formados en una lectura de %zd bytes", ret);
+        n += got;
+    }
+    kunit_kfree(test, buf);
+    return n;
+}
+
+/*Cambia la capacidad de las clases: vacía el buffer, libera los arreglos y los vuelve a reservar con sizes
+*Los arreglos se liberan sin esperar a los lectores optimistas, no debe haber otros usuarios del dispositivo durante las pruebas
+*/
+static int test_resize(const unsigned int *sizes) {
+    int p;
+
+    clear_chardev();
+    synchronize_rcu();
+    flush_work(&reclaim_work);
+    rings_free();
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        ring_entries[p] = sizes[p];
+    }
+    return rings_init();
+}
+
+/*Desbordamiento de una clase: se escriben 2*size+3 mensajes, quedan los size más recientes en orden
+*y las entradas desalojadas se cuentan en evicted
+*/
+static void chardev_test_wrap(struct kunit *test) {
+    struct chardev_ring *ring = &circ_buffer.rings[CHARDEV_PRIO_NORMAL];
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_TEXT);
+    unsigned int size = ring->size, total = 2 * size + 3, i;
+    u64 first = READ_ONCE(circ_buffer.next_seq), evicted = ring->evicted;
+    struct test_record *records;
+    int n;
+
+    records = kunit_kcalloc(test, size + 1, sizeof(*records), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, records);
+    for (i = 0; i < total; i++) {
+        test_message(test, tf, -1, "wrap %u", i);
+    }
+    KUNIT_EXPECT_EQ(test, ring->count, size);
+    KUNIT_EXPECT_EQ(test, ring->evicted - evicted, (u64)(total - size));
+    KUNIT_EXPECT_EQ(test, count_entries(CHARDEV_PRIO_ALL), (u64)size);
+
+    n = test_records(test, tf, records, size + 1);
+    KUNIT_ASSERT_EQ(test, n, (int)size);
+    for (i = 0; i < size; i++) {
+        char expected[TEST_MESSAGE];
+
+        snprintf(expected, sizeof(expected), "wrap %u", total - size + i);
+        KUNIT_EXPECT_EQ(test, records[i].head.seq, first + total - size + i);
+        KUNIT_EXPECT_EQ(test, records[i].head.prio, (u8)CHARDEV_PRIO_NORMAL);
+        KUNIT_EXPECT_STREQ(test, records[i].msg, expected);
+    }
+}
+
+/*Orden entre clases: los números de secuencia son comunes a las clases, una lectura de todas las clases
+*entrega los mensajes en orden de escritura y una lectura de una sola clase entrega solo los suyos
+*/
+static void chardev_test_priorities(struct kunit *test) {
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_TEXT);
+    unsigned int per_class = U32_MAX, total, i;
+    struct test_record *records;
+    u64 first = READ_ONCE(circ_buffer.next_seq);
+    int p, n;
+
+    //Se escriben a lo más size mensajes por clase para que ninguna desaloje
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        per_class = min(per_class, circ_buffer.rings[p].size);
+    }
+    total = per_class * CHARDEV_PRIO_COUNT;
+    records = kunit_kcalloc(test, total + 1, sizeof(*records), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, records);
+    for (i = 0; i < total; i++) {
+        test_message(test, tf, i % CHARDEV_PRIO_COUNT, "prio %u", i);
+    }
+
+    n = test_records(test, tf, records, total + 1);
+    KUNIT_ASSERT_EQ(test, n, (int)total);
+    for (i = 0; i < total; i++) {
+        char expected[TEST_MESSAGE];
+
+        snprintf(expected, sizeof(expected), "prio %u", i);
+        KUNIT_EXPECT_EQ(test, records[i].head.seq, first + i);
+        KUNIT_EXPECT_EQ(test, records[i].head.prio, (u8)(i % CHARDEV_PRIO_COUNT));
+        KUNIT_EXPECT_STREQ(test, records[i].msg, expected);
+    }
+
+    //Solo la clase crítica, en orden y sin saltarse ninguna de sus entradas
+    tf->file.read_mask = CHARDEV_PRIO_MASK(CHARDEV_PRIO_CRITICAL);
+    tf->filp.f_pos = 0;
+    n = test_records(test, tf, records, total + 1);
+    KUNIT_ASSERT_EQ(test, n, (int)per_class);
+    for (i = 0; i < per_class; i++) {
+        KUNIT_EXPECT_EQ(test, records[i].head.seq, first + i * CHARDEV_PRIO_COUNT + CHARDEV_PRIO_CRITICAL);
+        KUNIT_EXPECT_EQ(test, records[i].head.prio, (u8)CHARDEV_PRIO_CRITICAL);
+    }
+}
+
+/*CLEAR: vacía todas las clases y los lectores no vuelven a ver las entradas anteriores,
+*los números de secuencia siguen creciendo para que las posiciones guardadas no apunten a entradas nuevas
+*/
+static void chardev_test_clear(struct kunit *test) {
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_TEXT);
+    struct test_record records[2];
+    char buf[TEST_MESSAGE];
+    unsigned int i;
+    u64 next;
+    int p;
+
+    for (i = 0; i < 5; i++) {
+        test_message(test, tf, i % CHARDEV_PRIO_COUNT, "clear %u", i);
+    }
+    next = READ_ONCE(circ_buffer.next_seq);
+    KUNIT_ASSERT_EQ(test, test_write(tf, "CLEAR", 5), (ssize_t)5);
+
+    KUNIT_EXPECT_EQ(test, count_entries(CHARDEV_PRIO_ALL), 0ULL);
+    KUNIT_EXPECT_EQ(test, circ_buffer.count, 0);
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        KUNIT_EXPECT_EQ(test, circ_buffer.rings[p].count, 0U);
+    }
+    KUNIT_EXPECT_EQ(test, test_read(tf, buf, sizeof(buf)), (ssize_t)0);
+    KUNIT_EXPECT_EQ(test, READ_ONCE(circ_buffer.next_seq), next);
+
+    test_message(test, tf, -1, "after %u", 0);
+    tf->filp.f_pos = 0;
+    KUNIT_ASSERT_EQ(test, test_records(test, tf, records, ARRAY_SIZE(records)), 1);
+    KUNIT_EXPECT_EQ(test, records[0].head.seq, next);
+    KUNIT_EXPECT_STREQ(test, records[0].msg, "after 0");
+}
+
+/*Formato binario: una escritura con varios registros guarda una entrada por registro con su clase,
+*y un registro inválido (longitud 0, mayor que el límite, que no cabe en la escritura o clase inexistente) se rechaza con
+*EINVAL sin guardar nada
+*/
+static void chardev_test_records(struct kunit *test) {
+    static const char * const msgs[] = { "a", "registro8", "trece bytes!!" };
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_BINARY);
+    struct test_record records[ARRAY_SIZE(msgs) + 1];
+    struct chardev_record head;
+    size_t size = 0, off = 0;
+    char *buf;
+    u64 first = READ_ONCE(circ_buffer.next_seq), next;
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+        size += CHARDEV_RECORD_SIZE(strlen(msgs[i]));
+    }
+    buf = kunit_kzalloc(test, size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+        memset(&head, 0, sizeof(head));
+        head.len = strlen(msgs[i]);
+        head.prio = i;
+        memcpy(buf + off, &head, sizeof(head));
+        memcpy(buf + off + sizeof(head), msgs[i], head.len);
+        off += CHARDEV_RECORD_SIZE(head.len);
+    }
+    KUNIT_ASSERT_EQ(test, test_write(tf, buf, size), (ssize_t)size);
+
+    //La lectura binaria devuelve los mismos registros con su número de secuencia y el relleno en cero
+    KUNIT_ASSERT_EQ(test, test_records(test, tf, records, ARRAY_SIZE(records)), (int)ARRAY_SIZE(msgs));
+    for (i = 0; i < ARRAY_SIZE(msgs); i++) {
+        KUNIT_EXPECT_EQ(test, records[i].head.len, (u32)strlen(msgs[i]));
+        KUNIT_EXPECT_EQ(test, records[i].head.prio, (u8)i);
+        KUNIT_EXPECT_EQ(test, records[i].head.seq, first + i);
+        KUNIT_EXPECT_EQ(test, records[i].head.weight, 1U);
+        KUNIT_EXPECT_STREQ(test, records[i].msg, msgs[i]);
+    }
+
+    //Registros inválidos, la cabecera se reutiliza en el primer registro del buffer
+    next = READ_ONCE(circ_buffer.next_seq);
+    memset(&head, 0, sizeof(head));
+    memcpy(buf, &head, sizeof(head));
+    KUNIT_EXPECT_EQ(test, test_write(tf, buf, size), (ssize_t)-EINVAL);
+    head.len = U32_MAX - 6;
+    memcpy(buf, &head, sizeof(head));
+    KUNIT_EXPECT_EQ(test, test_write(tf, buf, size), (ssize_t)-EINVAL);
+    head.len = size;
+    memcpy(buf, &head, sizeof(head));
+    KUNIT_EXPECT_EQ(test, test_write(tf, buf, size), (ssize_t)-EINVAL);
+    head.len = 1;
+    head.prio = CHARDEV_PRIO_COUNT;
+    memcpy(buf, &head, sizeof(head));
+    KUNIT_EXPECT_EQ(test, test_write(tf, buf, size), (ssize_t)-EINVAL);
+    KUNIT_EXPECT_EQ(test, test_write(tf, buf, sizeof(head) - 1), (ssize_t)-EINVAL);
+    KUNIT_EXPECT_EQ(test, READ_ONCE(circ_buffer.next_seq), next);
+}
+
+/*LAST: la lectura siguiente al comando entrega solo la entrada más reciente, y el modo dura una sola lectura*/
+static void chardev_test_last(struct kunit *test) {
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_TEXT);
+    struct test_record records[4];
+    unsigned int i;
+
+    for (i = 0; i < 3; i++) {
+        test_message(test, tf, i % CHARDEV_PRIO_COUNT, "last %u", i);
+    }
+    KUNIT_ASSERT_EQ(test, test_write(tf, "LAST", 4), (ssize_t)4);
+    KUNIT_ASSERT_EQ(test, test_records(test, tf, records, ARRAY_SIZE(records)), 1);
+    KUNIT_EXPECT_STREQ(test, records[0].msg, "last 2");
+
+    tf->filp.f_pos = 0;
+    KUNIT_EXPECT_EQ(test, test_records(test, tf, records, ARRAY_SIZE(records)), 3);
+}
+
+/*Escritores y lectores concurrentes:
+*Cada escritor escribe TEST_THREAD_WRITES mensajes "id n" en la clase crítica mientras un lector lee sin parar,
+*ninguna escritura se pierde (next_seq avanza una vez por mensaje) y el lector ve los números de secuencia en orden creciente
+*y los mensajes de cada escritor en el orden en que se escribieron
+*/
+struct test_thread {
+    struct test_file *tf;
+    unsigned int id;
+    atomic_t *running;
+    struct completion done;
+    int errors;
+    unsigned int seen;
+};
+
+static int test_writer(void *arg) {
+    struct test_thread *thread = arg;
+    char msg[TEST_MESSAGE];
+    unsigned int i;
+
+    for (i = 0; i < TEST_THREAD_WRITES; i++) {
+        int len = snprintf(msg, sizeof(msg), "%c%u %u", CHARDEV_PRIO_TAG(CHARDEV_PRIO_CRITICAL), thread->id, i);
+
+        if (test_write(thread->tf, msg, len) != len) {
+            thread->errors++;
+        }
+        cond_resched();
+    }
+    atomic_dec(thread->running);
+    complete(&thread->done);
+    return 0;
+}
+
+static int test_reader(void *arg) {
+    struct test_thread *thread = arg;
+    struct test_record *records = kcalloc(TEST_READER_RECORDS, sizeof(*records), GFP_KERNEL);
+    char *buf = kmalloc(TEST_READER_RECORDS * sizeof(struct chardev_record), GFP_KERNEL);
+    unsigned int last[TEST_THREADS] = { 0 };
+    bool seen[TEST_THREADS] = { false };
+    u64 prev = 0;
+
+    if (!records || !buf) {
+        thread->errors++;
+        goto out;
+    }
+    thread->tf->file.format = CHARDEV_FORMAT_BINARY;
+    /*Se lee hasta que terminan los escritores y una vez más para lo que quedó,
+    *cada registro ocupa más que su cabecera así que en una lectura caben a lo más TEST_READER_RECORDS
+    */
+    for (;;) {
+        bool finished = atomic_read(thread->running) == 0;
+        ssize_t ret = test_read(thread->tf, buf, TEST_READER_RECORDS * sizeof(struct chardev_record));
+        int i, n;
+
+        if (ret < 0) {
+            thread->errors++;
+            break;
+        }
+        n = test_decode(buf, ret, records, TEST_READER_RECORDS);
+        if (n < 0) {
+            thread->errors++;
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            unsigned int id, k;
+
+            if ((prev && records[i].head.seq <= prev) ||
+                sscanf(records[i].msg, "%u %u", &id, &k) != 2 || id >= TEST_THREADS ||
+                (seen[id] && k <= last[id])) {
+                thread->errors++;
+            } else {
+                seen[id] = true;
+                last[id] = k;
+            }
+            prev = records[i].head.seq;
+            thread->seen++;
+        }
+        if (finished && ret == 0) {
+            break;
+        }
+        cond_resched();
+    }
+out:
+    kfree(buf);
+    kfree(records);
+    complete(&thread->done);
+    return 0;
+}
+
+static void chardev_test_concurrent(struct kunit *test) {
+    struct test_thread *threads = kunit_kcalloc(test, TEST_THREADS + 1, sizeof(*threads), GFP_KERNEL);
+    struct chardev_ring *ring = &circ_buffer.rings[CHARDEV_PRIO_CRITICAL];
+    u64 first = READ_ONCE(circ_buffer.next_seq), total = TEST_THREADS * TEST_THREAD_WRITES;
+    atomic_t running = ATOMIC_INIT(TEST_THREADS);
+    int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, threads);
+    for (i = 0; i <= TEST_THREADS; i++) {
+        struct task_struct *task;
+
+        threads[i].tf = test_open(test, CHARDEV_FORMAT_TEXT);
+        threads[i].id = i;
+        threads[i].running = &running;
+        init_completion(&threads[i].done);
+        task = kthread_run(i < TEST_THREADS ? test_writer : test_reader, &threads[i], "chardev_test/%d", i);
+        if (IS_ERR(task)) {
+            //Los hilos que ya arrancaron usan el contador de la pila de la prueba, se esperan antes de fallar
+            if (i < TEST_THREADS) {
+                atomic_sub(TEST_THREADS - i, &running);
+            }
+            while (i--) {
+                wait_for_completion(&threads[i].done);
+            }
+            KUNIT_FAIL(test, "kthread_run: %ld", PTR_ERR(task));
+            return;
+        }
+    }
+    for (i = 0; i <= TEST_THREADS; i++) {
+        wait_for_completion(&threads[i].done);
+        KUNIT_EXPECT_EQ_MSG(test, threads[i].errors, 0, "hilo %d", i);
+    }
+
+    KUNIT_EXPECT_EQ(test, READ_ONCE(circ_buffer.next_seq) - first, total);
+    KUNIT_EXPECT_EQ(test, (u64)ring->count, min_t(u64, total, ring->size));
+    KUNIT_EXPECT_GT(test, threads[TEST_THREADS].seen, 0U);
+}
+
+/*Mediciones de tiempo (ns por operación) de escritura y lectura con varias capacidades de las clases,
+*los resultados salen en dmesg y no fallan la prueba, la capacidad original se restaura en chardev_test_exit
+*/
+static const unsigned int bench_sizes[] = { 16, 1024, 65536 };
+
+static void bench_desc(const unsigned int *size, char *desc) {
+    snprintf(desc, KUNIT_PARAM_DESC_SIZE, "ring_entries=%u", *size);
+}
+
+KUNIT_ARRAY_PARAM(bench, bench_sizes, bench_desc);
+
+static void test_bench_resize(struct kunit *test) {
+    const unsigned int *size = test->param_value;
+    unsigned int sizes[CHARDEV_PRIO_COUNT];
+    int p;
+
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        sizes[p] = *size;
+    }
+    KUNIT_ASSERT_EQ(test, test_resize(sizes), 0);
+}
+
+static void chardev_bench_write(struct kunit *test) {
+    const unsigned int size = *(const unsigned int *)test->param_value;
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_TEXT);
+    unsigned int i, n = clamp(4 * size, 10000U, 200000U);
+    u64 start;
+
+    test_bench_resize(test);
+    start = ktime_get_ns();
+    for (i = 0; i < n; i++) {
+        test_message(test, tf, -1, "bench %08u", i);
+    }
+    kunit_info(test, "escritura ring_entries=%u: %llu ns/op (%u mensajes)\n", size,
+               div_u64(ktime_get_ns() - start, n), n);
+    KUNIT_EXPECT_EQ(test, circ_buffer.rings[CHARDEV_PRIO_NORMAL].count, min(n, size));
+}
+
+static void chardev_bench_read(struct kunit *test) {
+    const unsigned int size = *(const unsigned int *)test->param_value;
+    struct test_file *tf = test_open(test, CHARDEV_FORMAT_BINARY);
+    char *buf = kunit_kmalloc(test, TEST_READ_SIZE, GFP_KERNEL);
+    unsigned int i, rounds = max(1U, 100000U / size);
+    u64 start, entries = 0;
+
+    KUNIT_ASSERT_NOT_NULL(test, buf);
+    test_bench_resize(test);
+    tf->file.format = CHARDEV_FORMAT_TEXT;
+    for (i = 0; i < size; i++) {
+        test_message(test, tf, -1, "bench %08u", i);
+    }
+    tf->file.format = CHARDEV_FORMAT_BINARY;
+
+    start = ktime_get_ns();
+    for (i = 0; i < rounds; i++) {
+        ssize_t ret;
+
+        tf->filp.f_pos = 0;
+        while ((ret = test_read(tf, buf, TEST_READ_SIZE)) > 0) {
+            entries += ret / CHARDEV_RECORD_SIZE(strlen("bench 00000000"));
+        }
+        KUNIT_ASSERT_EQ(test, ret, (ssize_t)0);
+    }
+    KUNIT_EXPECT_EQ(test, entries, (u64)rounds * size);
+    kunit_info(test, "lectura ring_entries=%u: %llu ns/entrada (%u lecturas completas)\n", size,
+               div_u64(ktime_get_ns() - start, max_t(u64, entries, 1)), rounds);
+}
+
+/*Cada prueba empieza con el buffer vacío y sin agrupar repeticiones ni presupuesto de bytes,
+*al terminar se restauran los parámetros y la capacidad original y se vacía el buffer
+*/
+static int chardev_test_init(struct kunit *test) {
+    test_dedup = dedup;
+    test_max_bytes = max_bytes;
+    memcpy(test_ring_entries, ring_entries, sizeof(test_ring_entries));
+    dedup = false;
+    max_bytes = 0;
+    clear_chardev();
+    return 0;
+}
+
+static void chardev_test_exit(struct kunit *test) {
+    if (memcmp(test_ring_entries, ring_entries, sizeof(test_ring_entries)) != 0) {
+        if (test_resize(test_ring_entries)) {
+            kunit_err(test, "no se pudo restaurar la capacidad de las clases\n");
+        }
+    }
+    clear_chardev();
+    dedup = test_dedup;
+    max_bytes = test_max_bytes;
+}
+
+static struct kunit_case chardev_test_cases[] = {
+    KUNIT_CASE(chardev_test_wrap),
+    KUNIT_CASE(chardev_test_priorities),
+    KUNIT_CASE(chardev_test_clear),
+    KUNIT_CASE(chardev_test_records),
+    KUNIT_CASE(chardev_test_last),
+    KUNIT_CASE_SLOW(chardev_test_concurrent),
+    KUNIT_CASE_PARAM(chardev_bench_write, bench_gen_params),
+    KUNIT_CASE_PARAM(chardev_bench_read, bench_gen_params),
+    {}
+};
+
+static struct kunit_suite chardev_test_suite = {
+    .name = "chardev",
+    .init = chardev_test_init,
+    .exit = chardev_test_exit,
+    .test_cases = chardev_test_cases,
+};
+
+kunit_test_suite(chardev_test_suite);
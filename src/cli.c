@@ -2,78 +2,952 @@
 *<unistd.h>: para open(), close(), read() y write()
 *<unistd.h>: para flags
 *VRGCLI: habilita funcionalidad CLI de vrg.h
+*<sys/ioctl.h>, "chardev_ioctl.h": comandos de control del dispositivo
+*<time.h>: reloj monotónico, el mismo que usa el módulo para las marcas de tiempo
+*<liburing.h>: lecturas por lotes con io_uring (opcional, el Makefile define HAVE_LIBURING si liburing está instalado)
+*<pthread.h>: escritores y lector concurrentes de --bench
+*"libchardev.h": biblioteca con las operaciones del dispositivo, el CLI abre el dispositivo una sola vez
+*<sys/eventfd.h>: avisos de entradas nuevas de --watch
+*<linux/perf_event.h>, <sys/syscall.h>: contadores de hardware de --profile (perf_event_open no tiene función en la libc)
 */
 #include<stdio.h>
 #include<stdlib.h>
+#include<errno.h>
 #include<unistd.h> 
 #include<fcntl.h>
+#include<sys/ioctl.h>
+#include<time.h>
+#include<pthread.h>
+#include<sys/eventfd.h>
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#include "libchardev.h"
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
 #define VRGCLI
 #include "vrg.h"
 
 /*Configuración del dispositivo:
-*DEVICE_PATH: ruta del dispositivo creado por el driver
 *ENTRY_SIZE: define el tamaño máximo en bytes para cada entrada del buffer 
 *MAX_ENTRIES: define la capacidad máxima de mensjaes en el buffer circular
 */
-#define DEVICE_PATH "/dev/chardev"
 #define ENTRY_SIZE 128
 #define MAX_ENTRIES 10
 
+/*Configuración de io_uring:
+*URING_BATCH: lecturas que se envían juntas en cada lote
+*URING_CHUNK: tamaño del buffer de cada lectura, un múltiplo de la página como los bloques de chardev_stream_text
+*/
+#define URING_BATCH 8
+#define URING_CHUNK (64 * 1024)
+
+//Buffer de la salida estándar cuando no es una terminal, las lecturas grandes se escriben en pocas llamadas a write()
+#define OUTPUT_BUFFER (1024 * 1024)
+
+/*Filtro que se instala en el descriptor antes de leer (--prefix, --grep), se aplica dentro del módulo*/
+static struct chardev_filter read_filter = { .type = CHARDEV_FILTER_NONE };
+
+/*Función para configurar el filtro de lectura:
+*type: CHARDEV_FILTER_PREFIX o CHARDEV_FILTER_SUBSTR
+*pattern: texto a buscar, se trunca a CHARDEV_FILTER_MAX_PATTERN bytes
+*/
+void set_read_filter(unsigned int type, const char *pattern){
+	size_t len = strlen(pattern);
+
+	if (len == 0) {
+		fprintf(stderr, "Error: El filtro no puede estar vacio\n");
+		return;
+	}
+	if (len > CHARDEV_FILTER_MAX_PATTERN) {
+		len = CHARDEV_FILTER_MAX_PATTERN;
+	}
+	read_filter.type = type;
+	read_filter.len = len;
+	memcpy(read_filter.pattern, pattern, len);
+}
+
+/*Prioridades que se instalan en el descriptor (--prio, --classes), por defecto escribe con prioridad normal y lee todas las clases*/
+static struct chardev_prio prio_config = { .write_prio = CHARDEV_PRIO_NORMAL, .read_mask = CHARDEV_PRIO_ALL };
+
+//Nombres de las clases de prioridad, en el orden de CHARDEV_PRIO_*
+static const char *prio_names[CHARDEV_PRIO_COUNT] = { "low", "normal", "critical" };
+
+//Función para obtener la clase de prioridad a partir de su nombre, retorna -1 si no existe
+int parse_prio(const char *name, size_t len){
+	for (int p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+		if (strlen(prio_names[p]) == len && strncmp(prio_names[p], name, len) == 0) {
+			return p;
+		}
+	}
+	fprintf(stderr, "Error: Prioridad desconocida '%.*s' (low, normal o critical)\n", (int)len, name);
+	return -1;
+}
+
+//Función para configurar la prioridad de las escrituras siguientes
+void set_write_prio(const char *name){
+	int p = parse_prio(name, strlen(name));
+
+	if (p >= 0) {
+		prio_config.write_prio = p;
+	}
+}
+
+/*Función para configurar las clases que se leen:
+*list: nombres de las clases separados por comas, por ejemplo "critical,normal"
+*/
+void set_read_classes(const char *list){
+	unsigned int mask = 0;
+
+	while (*list) {
+		size_t len = strcspn(list, ",");
+		int p = parse_prio(list, len);
+
+		if (p < 0) {
+			return;
+		}
+		mask |= CHARDEV_PRIO_MASK(p);
+		list += len;
+		if (*list == ',') {
+			list++;
+		}
+	}
+	if (mask == 0) {
+		fprintf(stderr, "Error: Se debe indicar al menos una clase\n");
+		return;
+	}
+	prio_config.read_mask = mask;
+}
+
+/*Dispositivo abierto por el CLI:
+*Se abre la primera vez que se usa y todas las opciones comparten el mismo descriptor, se cierra al terminar main
+*Se abre para lectura y escritura, y solo para lectura si no hay permiso de escritura
+*/
+static struct chardev_handle *shared_dev;
+
+struct chardev_handle *device(void){
+	if (shared_dev) {
+		return shared_dev;
+	}
+	shared_dev = chardev_open(CHARDEV_PATH, O_RDWR);
+	if (!shared_dev && (errno == EACCES || errno == EPERM)) {
+		shared_dev = chardev_open(CHARDEV_PATH, O_RDONLY);
+	}
+	if (!shared_dev) {
+		fprintf(stderr, "Error: No se logro abrir el char device\n");
+	}
+	return shared_dev;
+}
+
+/*Función para instalar las prioridades en el dispositivo
+*Retorna -1 si el módulo las rechaza
+*/
+int apply_prio(struct chardev_handle *dev){
+	if (prio_config.write_prio == CHARDEV_PRIO_NORMAL && prio_config.read_mask == CHARDEV_PRIO_ALL) {
+		return 0;
+	}
+	if (chardev_set_prio(dev, &prio_config) == -1) {
+		fprintf(stderr, "Error: No se logro configurar la prioridad\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*Función para instalar el filtro de lectura y las clases que se leen en el dispositivo
+*Retorna -1 si el módulo rechaza el filtro
+*/
+int apply_read_filter(struct chardev_handle *dev){
+	if (apply_prio(dev) == -1) {
+		return -1;
+	}
+	if (read_filter.type == CHARDEV_FILTER_NONE) {
+		return 0;
+	}
+	if (chardev_set_filter(dev, &read_filter) == -1) {
+		fprintf(stderr, "Error: No se logro configurar el filtro\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*Formato de salida de las lecturas (--format):
+*OUTPUT_TEXT: los mensajes tal como los entrega el módulo
+*OUTPUT_JSON: una línea JSON por entrada, decodificada del formato binario del módulo
+*/
+#define OUTPUT_TEXT 0
+#define OUTPUT_JSON 1
+static int output_format = OUTPUT_TEXT;
+
+//Función para elegir el formato de salida
+void set_output_format(const char *name){
+	if (strcmp(name, "text") == 0) {
+		output_format = OUTPUT_TEXT;
+	} else if (strcmp(name, "json") == 0) {
+		output_format = OUTPUT_JSON;
+	} else {
+		fprintf(stderr, "Error: Formato desconocido '%s' (text o json)\n", name);
+	}
+}
+
+/*Función para elegir el formato del dispositivo según el formato de salida
+*La salida JSON se arma con los registros binarios del módulo
+*Retorna -1 si el módulo no acepta el formato
+*/
+int apply_format(struct chardev_handle *dev){
+	if (chardev_set_format(dev, output_format == OUTPUT_JSON ? CHARDEV_FORMAT_BINARY : CHARDEV_FORMAT_TEXT) == -1) {
+		fprintf(stderr, "Error: No se logro configurar el formato de lectura\n");
+		return -1;
+	}
+	return 0;
+}
+
+//Escribe s como cadena JSON, escapando comillas, barras y caracteres de control
+void print_json_string(const char *s, size_t len){
+	putchar('"');
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = s[i];
+
+		if (c == '"' || c == '\\') {
+			printf("\\%c", c);
+		} else if (c == '\n') {
+			printf("\\n");
+		} else if (c == '\t') {
+			printf("\\t");
+		} else if (c < 0x20) {
+			printf("\\u%04x", c);
+		} else {
+			putchar(c);
+		}
+	}
+	putchar('"');
+}
+
+//Muestra un registro como una línea JSON
+void print_json_record(const struct chardev_record *record, const char *message, void *arg){
+	static const char *names[CHARDEV_PRIO_COUNT] = { "low", "normal", "critical" };
+
+	(void)arg;
+	printf("{\"seq\":%llu,\"timestamp_ns\":%llu,\"prio\":\"%s\",\"repeat\":%u,\"weight\":%u,\"len\":%u,\"message\":",
+	       (unsigned long long)record->seq, (unsigned long long)record->timestamp,
+	       record->prio < CHARDEV_PRIO_COUNT ? names[record->prio] : "unknown", record->repeat,
+	       record->weight ? record->weight : record->repeat + 1, record->len);
+	print_json_string(message, record->len);
+	printf("}\n");
+}
+
+/*Función para mostrar texto leído del dispositivo, agrega un salto de línea al final si falta*/
+void print_text(const char *text, size_t len){
+	if (len > 0) {
+		fwrite(text, 1, len, stdout);
+		if (text[len-1] != '\n') {
+			printf("\n");
+		}
+	}
+}
+
+//Escribe cada bloque leído en la salida y recuerda el último carácter para cerrar con un salto de línea
+void print_chunk(const char *text, size_t len, void *arg){
+	char *last = arg;
+
+	fwrite(text, 1, len, stdout);
+	*last = text[len-1];
+}
+
+/*Función para leer desde la posición actual hasta el final y mostrar el resultado en el formato de salida
+*Las lecturas se hacen por bloques de tamaño fijo, así la memoria no depende del tamaño del buffer del módulo
+*/
+void print_to_end(struct chardev_handle *dev){
+	char last = '\n';
+
+	if (output_format == OUTPUT_JSON) {
+		if (chardev_read_records(dev, print_json_record, NULL) == -1) {
+			fprintf(stderr, "Error: No se logro leer el char device\n");
+		}
+		return;
+	}
+	if (chardev_stream_text(dev, print_chunk, &last) == -1) {
+		fprintf(stderr, "Error: No se logro leer el char device\n");
+	}
+	if (last != '\n') {
+		printf("\n");
+	}
+}
+
 /*Función para leer el contenido del dispositivo:
 *last_only: bandera para leer solo el último mensaje(1) o todos(0)
-*Abre el dispositivo en modo lectura  o lectura/escritura
-*EN vñia el comando "LAST" si last_only es verdaderp
+*EN vñia el comando "LAST" si last_only es verdaderp, si no lee desde la entrada más antigua
 *Lee el contenido del buffer
 *Le da formato a la salida y la muestra. 
 */
 void read_chardev(int last_only){
-	/*Buffer sificiente para todas las entradas
-	*fd: descriptor de archivo
-	*bytes_read"bytes leídos 
-	*flags: modo de apertura condicional 
-	*/
-	char buffer[ENTRY_SIZE*MAX_ENTRIES];
-	int fd;
-	ssize_t bytes_read;
-	int flags = last_only ? O_RDWR : O_RDONLY;
-
-	//Abrir char device solo para lectura
-	fd = open(DEVICE_PATH, flags);
-	if(fd == -1){
-		fprintf(stderr, "Error: No se logro abrir el char device\n");
+	struct chardev_handle *dev = device();
+
+	if (!dev || apply_read_filter(dev) == -1 || apply_format(dev) == -1) {
 		return;
 	}
 
 	/*Manejo de comando LAST*/
 	if (last_only){
-		if (write(fd,"LAST", 4) == -1){
+		if (chardev_write(dev, "LAST", 4) == -1){
 			fprintf(stderr, "Error: No se logro enviar comando\n");
-			close(fd);
 			return;
 		}
+	} else if (chardev_seek(dev, 0, SEEK_SET) == -1) {
+		fprintf(stderr, "Error: No se logro posicionar la lectura\n");
+		return;
+	}
+	print_to_end(dev);
+}
 
+/*Función para mostrar la respuesta de una consulta por rango en el formato de salida*/
+void print_range(const char *buf, size_t len){
+	if (output_format == OUTPUT_JSON) {
+		chardev_decode_records(buf, len, print_json_record, NULL);
+	} else {
+		print_text(buf, len);
 	}
+}
+
+/*Función para leer las entradas de los últimos segundos:
+*seconds: tamaño de la ventana de tiempo hacia atrás desde ahora
+*Usa el ioctl CHARDEV_IOC_TIME_RANGE, el módulo solo copia las entradas dentro de la ventana
+*/
+void read_since(double seconds){
+	struct chardev_handle *dev;
+	struct timespec now;
+	unsigned long long now_ns, window_ns;
+	const char *buf;
+	size_t len;
 
-	/*Lee el contenido*/
-	bytes_read = read(fd, buffer, sizeof(buffer)-1); //Dejar espacio para \0
-	if(bytes_read == -1){
-		fprintf(stderr, "Error: No se logro leer el char devicee\n");
+	if (seconds < 0) {
+		fprintf(stderr, "Error: La ventana de tiempo debe ser positiva\n");
+		return;
+	}
+	dev = device();
+	if (!dev || apply_read_filter(dev) == -1 || apply_format(dev) == -1) {
 		return;
 	}
 
-	/*Formato y visualización de la salida:
-	*Agrega terminación nula 
-	*Agrega salto de linea al final*/
-	if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        printf("%s", buffer);
-        if (buffer[bytes_read-1] != '\n') {
-            printf("\n");
-        }
-    }
+	/*Calcula el rango [ahora - seconds, ahora] en ns del reloj monotónico*/
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns = (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	window_ns = (unsigned long long)(seconds * 1e9);
+
+	if (chardev_time_range(dev, window_ns < now_ns ? now_ns - window_ns : 0, now_ns, &buf, &len) == -1) {
+		fprintf(stderr, "Error: No se logro consultar el char device (%s)\n", strerror(errno));
+		return;
+	}
+	print_range(buf, len);
+}
+
+/*Función para leer las últimas n entradas:
+*Mueve la posición de lectura con lseek(SEEK_END, -n), en el módulo la posición es el índice de la entrada
+*Lee hasta el final del buffer, el módulo solo copia las entradas pedidas
+*/
+void read_tail(long n){
+	struct chardev_handle *dev;
+
+	if (n <= 0) {
+		fprintf(stderr, "Error: El numero de entradas debe ser positivo\n");
+		return;
+	}
+	dev = device();
+	if (!dev || apply_read_filter(dev) == -1 || apply_format(dev) == -1) {
+		return;
+	}
+	if (chardev_seek(dev, -n, SEEK_END) == -1) {
+		fprintf(stderr, "Error: No se logro posicionar la lectura\n");
+		return;
+	}
+	print_to_end(dev);
+}
+
+/*Función para leer un rango de entradas:
+*range: texto con el formato "i:j", índices inclusivos desde la entrada más antigua (0)
+*Usa el ioctl CHARDEV_IOC_READ_RANGE
+*/
+void read_range(const char *range){
+	struct chardev_handle *dev;
+	long long first, last;
+	const char *buf;
+	size_t len;
+
+	if (sscanf(range, "%lld:%lld", &first, &last) != 2 || first < 0 || last < first) {
+		fprintf(stderr, "Error: Rango invalido '%s', se espera i:j\n", range);
+		return;
+	}
+	dev = device();
+	if (!dev || apply_read_filter(dev) == -1 || apply_format(dev) == -1) {
+		return;
+	}
+	if (chardev_index_range(dev, first, last - first + 1, &buf, &len) == -1) {
+		fprintf(stderr, "Error: No se logro consultar el char device (%s)\n", strerror(errno));
+		return;
+	}
+	print_range(buf, len);
+}
+
+/*Función para leer el valor más reciente de una clave:
+*key: clave de los mensajes "clave=valor" (módulo cargado con keyed=1)
+*Usa el ioctl CHARDEV_IOC_KEY_LOOKUP, el módulo busca la clave en su índice sin recorrer el buffer
+*/
+void read_key(const char *key){
+	struct chardev_handle *dev = device();
+	const char *buf;
+	size_t len;
+
+	if (!dev || apply_prio(dev) == -1 || apply_format(dev) == -1) {
+		return;
+	}
+	if (chardev_key_lookup(dev, key, strlen(key), &buf, &len) == -1) {
+		if (errno == ENOENT) {
+			fprintf(stderr, "Error: La clave '%s' no tiene entradas\n", key);
+		} else if (errno == EOPNOTSUPP) {
+			fprintf(stderr, "Error: El modulo no indexa claves (cargarlo con keyed=1)\n");
+		} else {
+			fprintf(stderr, "Error: No se logro consultar el char device\n");
+		}
+		return;
+	}
+	print_range(buf, len);
+}
+
+//Tiempo del reloj monotónico en nanosegundos, para medir cada operación
+static long long now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#ifdef HAVE_LIBURING
+//Tiempo del reloj monotónico en segundos, para medir las lecturas
+static double now_seconds(void){
+	return now_ns() / 1e9;
+}
+
+/*Función para leer el dispositivo con io_uring:
+*Envía lotes de URING_BATCH lecturas en la posición actual del descriptor (offset -1)
+*Las lecturas de un lote van enlazadas (IOSQE_IO_HARDLINK) para que se ejecuten en orden aunque alguna sea corta
+*El módulo acepta IOCB_NOWAIT, así el kernel las completa en el mismo envío sin usar hilos de trabajo
+*Termina cuando una lectura retorna 0 (no quedan entradas)
+*/
+void read_uring(void){
+	static char buffers[URING_BATCH][URING_CHUNK];
+	ssize_t lengths[URING_BATCH];
+	struct io_uring ring;
+	struct io_uring_cqe *cqe;
+	struct chardev_handle *dev = device();
+	int fd, ret, done = 0;
+
+	/*El descriptor compartido se lleva a la entrada más antigua y al formato de texto antes de enviar las lecturas*/
+	if (!dev || apply_read_filter(dev) == -1 || chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1 ||
+	    chardev_seek(dev, 0, SEEK_SET) == -1) {
+		return;
+	}
+	fd = chardev_fd(dev);
+	ret = io_uring_queue_init(URING_BATCH, &ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "Error: No se logro crear el io_uring: %s\n", strerror(-ret));
+		return;
+	}
+
+	while (!done) {
+		/*Prepara el lote: cada lectura guarda su índice en user_data para ordenar las completaciones*/
+		for (int i = 0; i < URING_BATCH; i++) {
+			struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+			io_uring_prep_read(sqe, fd, buffers[i], URING_CHUNK, -1);
+			io_uring_sqe_set_data(sqe, (void *)(long)i);
+			if (i < URING_BATCH - 1) {
+				io_uring_sqe_set_flags(sqe, IOSQE_IO_HARDLINK);
+			}
+		}
+		ret = io_uring_submit_and_wait(&ring, URING_BATCH);
+		if (ret < 0) {
+			fprintf(stderr, "Error: No se logro enviar el lote: %s\n", strerror(-ret));
+			break;
+		}
+
+		/*Recoge las URING_BATCH completaciones*/
+		for (int i = 0; i < URING_BATCH; i++) {
+			if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+				done = 1;
+				break;
+			}
+			lengths[(long)io_uring_cqe_get_data(cqe)] = cqe->res;
+			io_uring_cqe_seen(&ring, cqe);
+		}
+
+		/*Muestra los resultados en el orden del lote hasta el final del buffer o un error*/
+		for (int i = 0; i < URING_BATCH && !done; i++) {
+			if (lengths[i] < 0) {
+				fprintf(stderr, "Error: No se logro leer el char device: %s\n", strerror(-lengths[i]));
+				done = 1;
+			} else if (lengths[i] == 0) {
+				done = 1;
+			} else {
+				fwrite(buffers[i], 1, lengths[i], stdout);
+			}
+		}
+	}
+	io_uring_queue_exit(&ring);
+}
+
+/*Función para medir las lecturas con io_uring contra pread:
+*n: número de lecturas de cada modo
+*Todas las lecturas empiezan en la entrada más antigua (offset explícito), así cada una copia el buffer completo
+*Muestra el tiempo por lectura y las lecturas por segundo de cada modo
+*/
+void bench_uring(long n){
+	static char buffers[URING_BATCH][URING_CHUNK];
+	struct io_uring ring;
+	struct io_uring_cqe *cqe;
+	off_t first;
+	double start, pread_time, uring_time;
+	long sent, completed = 0;
+	struct chardev_handle *dev;
+	int fd, ret;
+
+	if (n <= 0) {
+		fprintf(stderr, "Error: El numero de lecturas debe ser positivo\n");
+		return;
+	}
+	dev = device();
+	if (!dev || chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1) {
+		return;
+	}
+	fd = chardev_fd(dev);
+
+	/*La posición 0 se ajusta a la entrada más antigua que sigue en el buffer*/
+	first = lseek(fd, 0, SEEK_SET);
+	if (first == -1) {
+		fprintf(stderr, "Error: No se logro posicionar la lectura\n");
+		return;
+	}
+
+	/*Lecturas con pread, una llamada al sistema por lectura*/
+	start = now_seconds();
+	for (long i = 0; i < n; i++) {
+		if (pread(fd, buffers[0], URING_CHUNK, first) == -1) {
+			fprintf(stderr, "Error: No se logro leer el char device\n");
+			return;
+		}
+	}
+	pread_time = now_seconds() - start;
+
+	ret = io_uring_queue_init(URING_BATCH, &ring, 0);
+	if (ret < 0) {
+		fprintf(stderr, "Error: No se logro crear el io_uring: %s\n", strerror(-ret));
+		return;
+	}
+
+	/*Lecturas con io_uring, una llamada al sistema por lote de URING_BATCH lecturas*/
+	start = now_seconds();
+	for (sent = 0; sent < n || completed < n; ) {
+		unsigned int batch = 0;
+
+		while (sent < n && batch < URING_BATCH) {
+			struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+			io_uring_prep_read(sqe, fd, buffers[batch], URING_CHUNK, first);
+			sent++;
+			batch++;
+		}
+		ret = io_uring_submit_and_wait(&ring, batch);
+		if (ret < 0) {
+			fprintf(stderr, "Error: No se logro enviar el lote: %s\n", strerror(-ret));
+			break;
+		}
+		for (unsigned int i = 0; i < batch; i++) {
+			if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+				break;
+			}
+			if (cqe->res < 0) {
+				fprintf(stderr, "Error: Lectura fallida: %s\n", strerror(-cqe->res));
+			}
+			io_uring_cqe_seen(&ring, cqe);
+			completed++;
+		}
+	}
+	uring_time = now_seconds() - start;
+	io_uring_queue_exit(&ring);
+
+	printf("Lecturas: %ld de %d bytes desde la entrada %lld\n", n, URING_CHUNK, (long long)first);
+	printf("pread:    %.3f us por lectura, %.0f lecturas/s\n", pread_time * 1e6 / n, n / pread_time);
+	printf("io_uring: %.3f us por lectura, %.0f lecturas/s (lotes de %d)\n",
+	       uring_time * 1e6 / completed, completed / uring_time, URING_BATCH);
+}
+#else
+//Sin liburing los modos de io_uring solo muestran un error
+void read_uring(void){
+	fprintf(stderr, "Error: El CLI se compilo sin liburing\n");
+}
+
+void bench_uring(long n){
+	(void)n;
+	fprintf(stderr, "Error: El CLI se compilo sin liburing\n");
+}
+#endif
+
+/*Pruebas y mediciones del dispositivo (--bench N):
+*Se ejecutan sobre el módulo cargado y escriben entradas de prueba, las entradas actuales se desalojan y al final se limpia el buffer
+*Si el dispositivo tiene entradas la prueba se niega a correr, salvo que antes se pase --force (bench_force)
+*BENCH_WRITERS: hilos escritores de la prueba concurrente
+*BENCH_MESSAGE: tamaño de los mensajes de prueba (con el salto de línea)
+*BENCH_READ_SIZES: número de entradas que se leen en cada medición de lectura
+*/
+#define BENCH_WRITERS 4
+#define BENCH_MESSAGE 64
+static const long bench_read_sizes[] = { 1, 10, 100, 1000, 4096 };
+
+static int bench_failures;
+static int bench_force;
+
+//Muestra el resultado de una verificación
+static void bench_check(int ok, const char *name){
+	printf("  %-44s %s\n", name, ok ? "ok" : "FALLO");
+	if (!ok) {
+		bench_failures++;
+	}
+}
+
+static int compare_ns(const void *a, const void *b){
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+//Muestra el promedio por operación y la latencia p50, p99 y máxima de n operaciones (ordena lat)
+static void bench_report(const char *name, long long *lat, long n){
+	long long total = 0;
+
+	for (long i = 0; i < n; i++) {
+		total += lat[i];
+	}
+	qsort(lat, n, sizeof(*lat), compare_ns);
+	printf("  %-28s %9.0f ns/op  p50 %lld  p99 %lld  max %lld ns\n",
+	       name, (double)total / n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+}
+
+//Arma un mensaje de prueba distinto en cada llamada, así dedup no lo agrupa
+static void bench_message(char *msg, int writer, long id){
+	int len = snprintf(msg, BENCH_MESSAGE, "bench %d %ld ", writer, id);
+
+	memset(msg + len, '.', BENCH_MESSAGE - len - 1);
+	msg[BENCH_MESSAGE - 1] = '\n';
+}
+
+//Escribe un mensaje de prueba como una entrada
+static int bench_write_one(struct chardev_handle *dev, int writer, long id){
+	char msg[BENCH_MESSAGE];
+
+	bench_message(msg, writer, id);
+	return chardev_write(dev, msg, sizeof(msg));
+}
+
+//Estadísticas del dispositivo, retorna -1 si el ioctl falla
+static int bench_stats(struct chardev_handle *dev, struct chardev_stats *stats){
+	if (chardev_stats(dev, stats) == -1) {
+		fprintf(stderr, "Error: No se pudieron obtener las estadisticas\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*Recorrido de registros de una lectura:
+*records: registros leídos
+*last_seq: número de secuencia del registro anterior
+*ordered: falso si algún registro no llegó en orden estricto de número de secuencia
+*/
+struct bench_scan {
+	long records;
+	long long last_seq;
+	int ordered;
+};
+
+static void scan_record(const struct chardev_record *record, const char *message, void *arg){
+	struct bench_scan *scan = arg;
+
+	(void)message;
+	if ((long long)record->seq <= scan->last_seq) {
+		scan->ordered = 0;
+	}
+	scan->last_seq = record->seq;
+	scan->records++;
+}
+
+//Lee desde la posición actual hasta el final y recorre los registros, retorna -1 si falla la lectura
+static int scan_device(struct chardev_handle *dev, struct bench_scan *scan){
+	scan->records = 0;
+	scan->last_seq = -1;
+	scan->ordered = 1;
+	return chardev_read_records(dev, scan_record, scan);
+}
+
+/*Lector de la prueba concurrente:
+*Lee el dispositivo completo una y otra vez con su propio descriptor mientras los escritores trabajan,
+*y verifica que cada lectura llegue ordenada
+*/
+struct bench_reader {
+	struct chardev_handle *dev;
+	volatile int stop;
+	long reads;
+	int ordered;
+};
+
+static void *bench_reader_run(void *arg){
+	struct bench_reader *reader = arg;
+	struct bench_scan scan;
+
+	reader->ordered = 1;
+	while (!reader->stop) {
+		if (chardev_seek(reader->dev, 0, SEEK_SET) == -1 || scan_device(reader->dev, &scan) == -1) {
+			reader->ordered = 0;
+			break;
+		}
+		reader->ordered &= scan.ordered;
+		reader->reads++;
+	}
+	return NULL;
+}
+
+/*Escritor de la prueba concurrente:
+*Cada escritor usa su propio descriptor y guarda la latencia de cada escritura en lat
+*/
+struct bench_writer {
+	int id;
+	long n;
+	long long *lat;
+	int failed;
+};
+
+static void *bench_writer_run(void *arg){
+	struct bench_writer *writer = arg;
+	struct chardev_handle *dev = chardev_open(CHARDEV_PATH, O_WRONLY);
+
+	if (!dev || apply_prio(dev) == -1) {
+		writer->failed = 1;
+		chardev_close(dev);
+		return NULL;
+	}
+	for (long i = 0; i < writer->n; i++) {
+		long long start = now_ns();
+
+		if (bench_write_one(dev, writer->id, i) == -1) {
+			writer->failed = 1;
+			break;
+		}
+		writer->lat[i] = now_ns() - start;
+	}
+	chardev_close(dev);
+	return NULL;
+}
+
+/*Función de pruebas y mediciones del dispositivo:
+*n: operaciones de cada medición
+*1. Escritura: n escrituras secuenciales, verifica que el buffer se llene hasta su capacidad y desaloje las más antiguas.
+*También mide n mensajes con el escritor por lotes de libchardev (una llamada al sistema por lote)
+*2. LAST: el modo "last" entrega la entrada recién escrita
+*3. Lectura: lecturas de las últimas k entradas para varios k (hasta la capacidad de la clase), verifica cantidad y orden
+*4. Concurrencia: BENCH_WRITERS escritores con un lector continuo, mide la latencia de escritura con lecturas en curso
+*y verifica que no se pierdan escrituras y que las lecturas lleguen ordenadas
+*Las entradas se escriben con la prioridad de --prio y se leen con las clases de --classes
+*Se aconseja desactivar rate_limit y dedup durante la prueba, los contadores de escrituras no los consideran
+*/
+void bench_device(long n){
+	struct chardev_stats before, after;
+	struct bench_writer writers[BENCH_WRITERS];
+	struct bench_reader reader = {0};
+	struct bench_scan scan;
+	pthread_t threads[BENCH_WRITERS], reader_thread;
+	struct chardev_handle *dev = device();
+	long long *lat, start;
+	unsigned int prio = prio_config.write_prio;
+	long capacity, filled, per_writer;
+	char msg[BENCH_MESSAGE];
+
+	if (n <= 0) {
+		fprintf(stderr, "Error: El numero de operaciones debe ser positivo\n");
+		return;
+	}
+	if (!dev) {
+		return;
+	}
+	lat = calloc(n, sizeof(*lat));
+	if (!lat) {
+		fprintf(stderr, "Error: No se pudo asignar memoria\n");
+		return;
+	}
+	bench_failures = 0;
+	if (apply_read_filter(dev) == -1 || bench_stats(dev, &before) == -1) {
+		goto out;
+	}
+	//La prueba borra las entradas actuales, solo se permite con el dispositivo vacío o con --force
+	if (before.entries > 0 && !bench_force) {
+		fprintf(stderr, "Error: El dispositivo tiene %llu entradas y --bench las borra, usar --force antes de --bench para continuar\n",
+		        (unsigned long long)before.entries);
+		goto out;
+	}
+	capacity = before.prio_capacity[prio];
+	printf("Clase %s: capacidad %ld entradas, mensajes de %d bytes\n", prio_names[prio], capacity, BENCH_MESSAGE);
+
+	/*1. Escritura secuencial, una entrada por llamada y por lotes*/
+	printf("Escritura:\n");
+	for (long i = 0; i < n; i++) {
+		start = now_ns();
+		if (bench_write_one(dev, 0, i) == -1) {
+			fprintf(stderr, "Error: No se logro escribir en el dispositivo\n");
+			goto out;
+		}
+		lat[i] = now_ns() - start;
+	}
+	bench_report("write", lat, n);
+	if (bench_stats(dev, &after) == -1) {
+		goto out;
+	}
+	bench_check(after.next_seq - before.next_seq == (unsigned long long)n, "cada escritura recibe un numero de secuencia");
+	filled = (long)before.prio_entries[prio] + n;
+	bench_check((long)after.prio_entries[prio] == (filled < capacity ? filled : capacity), "el buffer se llena hasta su capacidad");
+	if (filled > capacity) {
+		bench_check(after.prio_evicted[prio] - before.prio_evicted[prio] == (unsigned long long)(filled - capacity),
+		            "las mas antiguas se desalojan");
+	}
+
+	before = after;
+	start = now_ns();
+	for (long i = 0; i < n; i++) {
+		bench_message(msg, 0, i);
+		if (chardev_append(dev, msg, sizeof(msg), -1) == -1) {
+			fprintf(stderr, "Error: No se logro escribir en el dispositivo\n");
+			goto out;
+		}
+	}
+	if (chardev_flush(dev) == -1 || bench_stats(dev, &after) == -1) {
+		fprintf(stderr, "Error: No se logro escribir en el dispositivo\n");
+		goto out;
+	}
+	printf("  %-28s %9.0f ns/op\n", "write (por lotes)", (double)(now_ns() - start) / n);
+	bench_check(after.next_seq - before.next_seq == (unsigned long long)n, "cada mensaje del lote es una entrada");
+
+	/*2. Modo LAST*/
+	printf("LAST:\n");
+	scan.records = 0;
+	if (bench_write_one(dev, 0, -1) == -1) {
+		fprintf(stderr, "Error: No se logro escribir en el dispositivo\n");
+		goto out;
+	}
+	{
+		const char *text;
+		ssize_t bytes_read;
+
+		if (chardev_write(dev, "LAST", 4) == -1 || chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1 ||
+		    (bytes_read = chardev_read_text(dev, &text)) == -1) {
+			fprintf(stderr, "Error: No se logro leer el char device\n");
+			goto out;
+		}
+		bench_check(bytes_read == BENCH_MESSAGE && strncmp(text, "bench 0 -1 ", 11) == 0,
+		            "LAST entrega la entrada mas reciente");
+	}
+
+	/*3. Lectura de las últimas k entradas*/
+	printf("Lectura:\n");
+	for (size_t s = 0; s < sizeof(bench_read_sizes) / sizeof(bench_read_sizes[0]); s++) {
+		long k = bench_read_sizes[s];
+		long expected = k < capacity ? k : capacity;
+		int ok = 1;
+		char name[64];
+
+		if (s > 0 && bench_read_sizes[s - 1] >= capacity) {
+			break;
+		}
+		for (long i = 0; i < n; i++) {
+			start = now_ns();
+			if (chardev_seek(dev, -k, SEEK_END) == -1 || scan_device(dev, &scan) == -1) {
+				fprintf(stderr, "Error: No se logro leer el char device\n");
+				goto out;
+			}
+			lat[i] = now_ns() - start;
+			ok &= scan.ordered && (prio_config.read_mask != CHARDEV_PRIO_MASK(prio) || scan.records == expected);
+		}
+		snprintf(name, sizeof(name), "read %ld", expected);
+		bench_report(name, lat, n);
+		snprintf(name, sizeof(name), "lectura de %ld entradas completa y ordenada", expected);
+		bench_check(ok, name);
+	}
 
-	/*Cerrar el descriptor de archivo*/
-	close(fd);
+	/*4. Escritores concurrentes con un lector continuo*/
+	printf("Concurrencia (%d escritores y un lector):\n", BENCH_WRITERS);
+	if (bench_stats(dev, &before) == -1) {
+		goto out;
+	}
+	per_writer = n / BENCH_WRITERS > 0 ? n / BENCH_WRITERS : 1;
+	reader.dev = chardev_open(CHARDEV_PATH, O_RDONLY);
+	if (!reader.dev || apply_read_filter(reader.dev) == -1 ||
+	    pthread_create(&reader_thread, NULL, bench_reader_run, &reader) != 0) {
+		fprintf(stderr, "Error: No se pudo iniciar el lector\n");
+		chardev_close(reader.dev);
+		goto out;
+	}
+	for (int w = 0; w < BENCH_WRITERS; w++) {
+		writers[w] = (struct bench_writer){ .id = w + 1, .n = per_writer, .lat = calloc(per_writer, sizeof(long long)) };
+		if (!writers[w].lat || pthread_create(&threads[w], NULL, bench_writer_run, &writers[w]) != 0) {
+			writers[w].failed = 1;
+			threads[w] = 0;
+		}
+	}
+	for (int w = 0; w < BENCH_WRITERS; w++) {
+		if (threads[w]) {
+			pthread_join(threads[w], NULL);
+		}
+	}
+	reader.stop = 1;
+	pthread_join(reader_thread, NULL);
+	chardev_close(reader.dev);
+
+	/*Junta las latencias de todos los escritores en lat*/
+	{
+		long total = 0;
+		int failed = 0;
+
+		for (int w = 0; w < BENCH_WRITERS; w++) {
+			failed |= writers[w].failed;
+			for (long i = 0; i < per_writer && writers[w].lat && total < n; i++) {
+				lat[total++] = writers[w].lat[i];
+			}
+			free(writers[w].lat);
+		}
+		if (total > 0) {
+			bench_report("write (con lector)", lat, total);
+		}
+		printf("  lecturas completas del lector: %ld\n", reader.reads);
+		if (bench_stats(dev, &after) == -1) {
+			goto out;
+		}
+		bench_check(!failed && after.next_seq - before.next_seq == (unsigned long long)(per_writer * BENCH_WRITERS),
+		            "no se pierden escrituras concurrentes");
+		bench_check(reader.ordered, "las lecturas concurrentes llegan ordenadas");
+		bench_check((long)after.prio_entries[prio] <= capacity, "el buffer no supera su capacidad");
+	}
+
+	/*5. CLEAR con el buffer lleno, su costo no debe crecer con la capacidad*/
+	printf("CLEAR:\n");
+	before = after;
+	start = now_ns();
+	if (chardev_clear(dev) == -1) {
+		fprintf(stderr, "Error: No se logro limpiar el dispositivo\n");
+		goto out;
+	}
+	printf("  %-28s %9lld ns (%llu entradas)\n", "clear", now_ns() - start, (unsigned long long)before.entries);
+	if (bench_stats(dev, &after) == -1) {
+		goto out;
+	}
+	bench_check(after.entries == 0 && after.entry_bytes == 0, "CLEAR deja el buffer vacio");
+	bench_check(after.next_seq == before.next_seq, "CLEAR conserva los numeros de secuencia");
+
+	printf("%s: %d verificaciones fallidas\n", bench_failures ? "FALLO" : "OK", bench_failures);
+out:
+	free(lat);
 }
 
 /*Función para escribir en el dispositivo: 
@@ -81,16 +955,14 @@ void read_chardev(int last_only){
 *Usa snprintf para dar formato de forma segura
 */
 void write_entry(const char *input){
-	int fd;
+	struct chardev_handle *dev = device();
 	char *msg = NULL;
 	size_t msg_len;
 
-	//Abrir char device solo para escritura
-	fd = open(DEVICE_PATH, O_WRONLY);
-	if(fd == -1){
-		fprintf(stderr, "Error: No se logro abrir el char device\n");
+	if (!dev || apply_prio(dev) == -1) {
 		return;
 	}
+
 	//Da formato al mensaje, se agrega +2 por +1 para /n y +1 para /0
 	msg_len = strlen(input) + 2;
     msg = malloc(msg_len);
@@ -98,84 +970,547 @@ void write_entry(const char *input){
 	//Verifica que se asigne la memoria correctamente 
     if (!msg) {
         fprintf(stderr, "Error: No se pudo asignar memoria\n");
-        close(fd);
         return;
     }
     
     snprintf(msg, msg_len, "%s\n", input);
 
-    if (write(fd, msg, strlen(msg)) == -1) {
+    if (chardev_write(dev, msg, strlen(msg)) == -1) {
         fprintf(stderr, "Error: No se logro al escribir en el dispositivo\n");
     }
 	free(msg);
-	close(fd);
 	}
 
+/*Función para escribir cada línea de la entrada estándar como una entrada:
+*Las líneas se acumulan con el escritor por lotes de libchardev y se envían varias en cada llamada al sistema,
+*cada línea queda como una entrada independiente
+*/
+void write_stdin(void){
+	struct chardev_handle *dev = device();
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	long lines = 0;
+
+	if (!dev || apply_prio(dev) == -1) {
+		return;
+	}
+	while ((len = getline(&line, &cap, stdin)) > 0) {
+		if (chardev_append(dev, line, len, -1) == -1) {
+			fprintf(stderr, "Error: No se logro al escribir en el dispositivo\n");
+			break;
+		}
+		lines++;
+	}
+	if (chardev_flush(dev) == -1) {
+		fprintf(stderr, "Error: No se logro al escribir en el dispositivo\n");
+	}
+	free(line);
+	if (chardev_dropped(dev) > 0) {
+		fprintf(stderr, "Aviso: El modulo rechazo %llu lineas (demasiado largas o sin memoria en el presupuesto)\n",
+		        chardev_dropped(dev));
+	}
+	printf("Lineas escritas: %lld\n", lines - (long long)chardev_dropped(dev));
+}
+
 /*FUnción para contar las entradas:
-*Lee todo el contenido del buffer
-*Divide cada entrada usando strok()
-*Toma cada linea como una entrada*/
+*Lee el dispositivo en formato binario y cuenta los registros
+*Así un mensaje con saltos de línea internos (o sin salto de línea final) cuenta como una sola entrada
+*/
+
+//Cuenta un registro decodificado
+void count_record(const struct chardev_record *record, const char *message, void *arg){
+	(void)record;
+	(void)message;
+	(*(long *)arg)++;
+}
+
 void count_entries() {
+    struct chardev_handle *dev = device();
+    long count = 0;
+
+    if (!dev || apply_read_filter(dev) == -1) {
+        return;
+    }
 
-	/*buffer: buffer para almacenar las entradas leídas
-	*count: contador para las entradas */
-    char buffer[ENTRY_SIZE * MAX_ENTRIES];
-    int fd; 
-    ssize_t bytes_read;  
-    int count = 0; 
-
-	/*Abre el dispositivo en modo lectura y si falla imprime error*/
-    fd = open(DEVICE_PATH, O_RDONLY); 
-    if(fd == -1){ 
-        fprintf(stderr, "Error: No se logró abrir el char device\n");
+	/*Lee todos los registros desde la entrada más antigua, cada uno es una entrada*/
+    if (chardev_seek(dev, 0, SEEK_SET) == -1 || chardev_read_records(dev, count_record, &count) == -1) {
+        fprintf(stderr, "Error: No se logró leer el char device\n");
         return;
     }
+    printf("Número de entradas: %ld\n", count);
+}
+
+/*Perfil de las operaciones con contadores de hardware (--profile N):
+*Cada operación se mide con un grupo de contadores de perf_event_open que se lee justo antes y justo después de ella,
+*así los ciclos, instrucciones, fallos de caché y cambios de contexto se atribuyen a esa operación
+*Los contadores incluyen el kernel (dev_read_iter, dev_write_iter, dev_ioctl) si perf_event_paranoid lo permite, si no solo el espacio usuario
+*La fila "vacia" mide el costo de leer los contadores sin operación, es el piso de las demás filas
+*PROFILE_READ_ENTRIES: entradas que lee cada operación de lectura (las más recientes)
+*/
+#define PROFILE_READ_ENTRIES 100
+
+/*Contadores del grupo:
+*name: nombre en el reporte
+*type, config: evento de perf_event_open
+*kernel_only: cuenta solo en modo kernel (exclude_user), se omite si no se permite contar el kernel
+*/
+static const struct profile_event {
+	const char *name;
+	__u32 type;
+	__u64 config;
+	int kernel_only;
+} profile_events[] = {
+	{ "ciclos", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0 },
+	{ "ciclos en kernel", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1 },
+	{ "instrucciones", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 },
+	{ "fallos de cache", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 0 },
+	{ "cambios de contexto", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0 },
+};
+#define PROFILE_EVENTS (sizeof(profile_events) / sizeof(profile_events[0]))
+#define PROFILE_CYCLES 0
+#define PROFILE_KERNEL_CYCLES 1
+#define PROFILE_INSTRUCTIONS 2
+
+/*Estado del perfil:
+*leader: descriptor del primer contador abierto, la lectura del grupo se hace sobre él
+*fd: descriptor de cada contador, -1 si no está disponible
+*slot: posición de cada contador en la lectura del grupo
+*count: contadores abiertos
+*kernel: los contadores incluyen el modo kernel
+*lat, values: tiempo y valor de cada contador en cada operación medida
+*/
+struct profile {
+	int leader;
+	int fd[PROFILE_EVENTS];
+	int slot[PROFILE_EVENTS];
+	int count;
+	int kernel;
+	long long *lat;
+	long long *values[PROFILE_EVENTS];
+};
+
+/*Lectura del grupo con PERF_FORMAT_GROUP: número de contadores, tiempos habilitado y contando, y un valor por contador*/
+struct profile_read {
+	__u64 nr;
+	__u64 time_enabled;
+	__u64 time_running;
+	__u64 values[PROFILE_EVENTS];
+};
+
+//Operación medida por el perfil, i es el número de la operación. Retorna -1 si falla
+typedef int (*profile_op)(struct chardev_handle *dev, long i);
+
+static int profile_open_event(const struct profile_event *event, int leader, int kernel){
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = event->type;
+	attr.config = event->config;
+	attr.disabled = leader == -1;
+	attr.exclude_hv = 1;
+	attr.exclude_kernel = !kernel;
+	attr.exclude_user = event->kernel_only;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static void profile_close(struct profile *prof){
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		if (prof->fd[e] != -1) {
+			close(prof->fd[e]);
+			prof->fd[e] = -1;
+		}
+	}
+	prof->leader = -1;
+}
+
+/*Abre el grupo de contadores del proceso:
+*Primero se intenta contar también el kernel, si no se permite (EACCES o EPERM) se repite solo con el espacio usuario
+*Los contadores que el equipo no tiene (por ejemplo una máquina virtual sin PMU) se omiten
+*Retorna -1 si no se pudo abrir ninguno
+*/
+static int profile_open(struct profile *prof){
+	for (prof->kernel = 1; prof->kernel >= 0; prof->kernel--) {
+		int denied = 0;
+
+		prof->leader = -1;
+		prof->count = 0;
+		for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+			prof->fd[e] = -1;
+			prof->slot[e] = -1;
+			if (profile_events[e].kernel_only && !prof->kernel) {
+				continue;
+			}
+			prof->fd[e] = profile_open_event(&profile_events[e], prof->leader, prof->kernel);
+			if (prof->fd[e] == -1) {
+				denied |= errno == EACCES || errno == EPERM;
+				continue;
+			}
+			if (prof->leader == -1) {
+				prof->leader = prof->fd[e];
+			}
+			prof->slot[e] = prof->count++;
+		}
+		if (prof->kernel && denied) {
+			profile_close(prof);
+			continue;
+		}
+		if (prof->leader == -1) {
+			return -1;
+		}
+		return ioctl(prof->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+	return -1;
+}
+
+static int profile_read(const struct profile *prof, struct profile_read *values){
+	return read(prof->leader, values, sizeof(*values)) > 0 ? 0 : -1;
+}
+
+//Muestra el promedio por operación y los valores p50, p99 y máximo de un contador (ordena values)
+static void profile_report_event(const char *name, long long *values, long n){
+	long long total = 0;
+
+	for (long i = 0; i < n; i++) {
+		total += values[i];
+	}
+	qsort(values, n, sizeof(*values), compare_ns);
+	printf("  %-28s %12.1f /op  p50 %lld  p99 %lld  max %lld\n",
+	       name, (double)total / n, values[n / 2], values[n * 99 / 100], values[n - 1]);
+}
+
+//Suma de un contador en las n operaciones, 0 si no está disponible
+static long long profile_total(const struct profile *prof, size_t e, long n){
+	long long total = 0;
+
+	if (prof->slot[e] == -1) {
+		return 0;
+	}
+	for (long i = 0; i < n; i++) {
+		total += prof->values[e][i];
+	}
+	return total;
+}
+
+/*Mide n veces la operación op y muestra el tiempo y cada contador:
+*setup (opcional) prepara cada operación fuera de la medición
+*Además del promedio se muestran las instrucciones por ciclo y la parte de los ciclos que se gastó en el kernel
+*/
+static int profile_run(struct profile *prof, struct chardev_handle *dev, const char *name, profile_op setup, profile_op op, long n){
+	struct profile_read before, after;
+	long long start, cycles, kernel_cycles, instructions;
+
+	for (long i = 0; i < n; i++) {
+		if (setup && setup(dev, i) == -1) {
+			return -1;
+		}
+		if (profile_read(prof, &before) == -1) {
+			return -1;
+		}
+		start = now_ns();
+		if (op(dev, i) == -1) {
+			return -1;
+		}
+		prof->lat[i] = now_ns() - start;
+		if (profile_read(prof, &after) == -1) {
+			return -1;
+		}
+		for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+			if (prof->slot[e] != -1) {
+				prof->values[e][i] = after.values[prof->slot[e]] - before.values[prof->slot[e]];
+			}
+		}
+	}
+
+	cycles = profile_total(prof, PROFILE_CYCLES, n);
+	kernel_cycles = profile_total(prof, PROFILE_KERNEL_CYCLES, n);
+	instructions = profile_total(prof, PROFILE_INSTRUCTIONS, n);
+	printf("%s:\n", name);
+	bench_report("tiempo", prof->lat, n);
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		if (prof->slot[e] != -1) {
+			profile_report_event(profile_events[e].name, prof->values[e], n);
+		}
+	}
+	if (cycles > 0 && instructions > 0) {
+		printf("  %-28s %12.2f\n", "instrucciones por ciclo", (double)instructions / cycles);
+	}
+	if (cycles > 0 && prof->slot[PROFILE_KERNEL_CYCLES] != -1) {
+		printf("  %-28s %11.1f%%\n", "ciclos en kernel", 100.0 * kernel_cycles / cycles);
+	}
+	return 0;
+}
 
-	/*Lee los datos del dispositivo y los almacena en buffer. -1 para dejar espacio para el caracter nulo
-	*Cierra el dispositivo despues de leerlo
-	*Si no se leyó nada se muestra 0 entradas
-	*/
-    bytes_read = read(fd, buffer, sizeof(buffer)-1); 
-    close(fd); 
-    if(bytes_read <= 0) {
-        printf("Número de entradas: 0\n");
+//Operaciones del perfil: vacía (costo de la medición), escritura, lectura de las últimas entradas, conteo y CLEAR
+static int profile_empty(struct chardev_handle *dev, long i){
+	(void)dev;
+	(void)i;
+	return 0;
+}
+
+static int profile_write(struct chardev_handle *dev, long i){
+	return bench_write_one(dev, 0, i);
+}
+
+static int profile_read_tail(struct chardev_handle *dev, long i){
+	const char *text;
+
+	(void)i;
+	if (chardev_seek(dev, -PROFILE_READ_ENTRIES, SEEK_END) == -1) {
+		return -1;
+	}
+	return chardev_read_text(dev, &text) == -1 ? -1 : 0;
+}
+
+static int profile_count(struct chardev_handle *dev, long i){
+	long count = 0;
+
+	(void)i;
+	if (chardev_seek(dev, 0, SEEK_SET) == -1) {
+		return -1;
+	}
+	return chardev_read_records(dev, count_record, &count);
+}
+
+static int profile_clear(struct chardev_handle *dev, long i){
+	(void)i;
+	return chardev_clear(dev);
+}
+
+/*Función para medir las operaciones del dispositivo con contadores de hardware:
+*n: operaciones de cada tipo, escribe entradas de prueba y al final limpia el buffer (como --bench, también requiere --force si hay entradas)
+*Antes de cada CLEAR se escribe una entrada fuera de la medición, así cada CLEAR vacía un buffer con entradas
+*/
+void profile_device(long n){
+	struct profile prof = { .leader = -1 };
+	struct chardev_handle *dev;
+	static const struct {
+		const char *name;
+		profile_op setup;
+		profile_op op;
+	} phases[] = {
+		{ "vacia (lectura de los contadores)", NULL, profile_empty },
+		{ "write", NULL, profile_write },
+		{ "read (ultimas entradas)", NULL, profile_read_tail },
+		{ "count (todo el buffer)", NULL, profile_count },
+		{ "clear", profile_write, profile_clear },
+	};
+	struct profile_read check;
+	struct chardev_stats stats;
+	int ok;
+
+	if (n <= 0) {
+		fprintf(stderr, "Error: El numero de operaciones debe ser positivo\n");
+		return;
+	}
+	dev = device();
+	if (!dev || apply_read_filter(dev) == -1 || bench_stats(dev, &stats) == -1) {
+		return;
+	}
+	//Igual que --bench, con entradas en el dispositivo se necesita --force
+	if (stats.entries > 0 && !bench_force) {
+		fprintf(stderr, "Error: El dispositivo tiene %llu entradas y --profile las borra, usar --force antes de --profile para continuar\n",
+		        (unsigned long long)stats.entries);
+		return;
+	}
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		prof.fd[e] = -1;
+	}
+	if (profile_open(&prof) == -1) {
+		fprintf(stderr, "Error: No se pudieron abrir los contadores de perf_event_open (%s)\n", strerror(errno));
+		profile_close(&prof);
+		return;
+	}
+	prof.lat = calloc(n, sizeof(*prof.lat));
+	ok = prof.lat != NULL;
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		if (prof.slot[e] != -1) {
+			prof.values[e] = calloc(n, sizeof(*prof.values[e]));
+			ok = ok && prof.values[e];
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "Error: No se pudo asignar memoria\n");
+		goto out;
+	}
+
+	printf("Operaciones: %ld de cada tipo, lecturas de %d entradas\n", n, PROFILE_READ_ENTRIES);
+	printf("Contadores: %s\n", prof.kernel ? "usuario y kernel" :
+	       "solo usuario (perf_event_paranoid no permite contar el kernel)");
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		if (prof.slot[e] == -1) {
+			printf("  %-28s no disponible\n", profile_events[e].name);
+		}
+	}
+	for (size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); p++) {
+		if (profile_run(&prof, dev, phases[p].name, phases[p].setup, phases[p].op, n) == -1) {
+			fprintf(stderr, "Error: Fallo la operacion %s\n", phases[p].name);
+			goto out;
+		}
+	}
+
+	/*Si el grupo no cupo en los contadores del CPU el kernel lo multiplexa y las operaciones sin contar suman 0*/
+	if (profile_read(&prof, &check) == 0 && check.time_running < check.time_enabled) {
+		printf("Aviso: los contadores se multiplexaron (%.0f%% del tiempo), los valores son aproximados\n",
+		       check.time_enabled ? 100.0 * check.time_running / check.time_enabled : 0.0);
+	}
+out:
+	free(prof.lat);
+	for (size_t e = 0; e < PROFILE_EVENTS; e++) {
+		free(prof.values[e]);
+	}
+	profile_close(&prof);
+}
+
+/*Función para mostrar las estadísticas del dispositivo:
+*Usa el ioctl CHARDEV_IOC_GET_STATS
+*La tasa de compresión es bytes originales / bytes guardados (1.00 sin compresión)
+*/
+void print_stats(void) {
+    struct chardev_stats stats;
+    struct chardev_handle *dev = device();
+
+    if (!dev) {
+        return;
+    }
+    if (chardev_stats(dev, &stats) == -1) {
+        fprintf(stderr, "Error: No se pudieron obtener las estadisticas\n");
         return;
     }
 
-	//Asegura que los datos leídos formen una cadena válida en C  terminando con el caracter nulo(Se hace para prevenir que siga leyendo datos fuera del buffer o zonas de memoria invalida)
-    buffer[bytes_read] = '\0'; 
+    printf("Entradas actuales: %llu\n", (unsigned long long)stats.entries);
+    printf("Entradas escritas: %llu\n", (unsigned long long)stats.next_seq);
+    printf("Entradas comprimidas: %llu\n", (unsigned long long)stats.compressed_entries);
+    printf("Mensajes repetidos agrupados: %llu\n", (unsigned long long)stats.repeated);
+    printf("Bytes originales: %llu\n", (unsigned long long)stats.raw_bytes);
+    printf("Bytes guardados: %llu\n", (unsigned long long)stats.stored_bytes);
+    printf("Tasa de compresion: %.2f\n",
+           stats.stored_bytes ? (double)stats.raw_bytes / stats.stored_bytes : 1.0);
+    printf("Memoria de entradas: %llu bytes\n", (unsigned long long)stats.entry_bytes);
+    printf("Memoria auxiliar: %llu bytes\n", (unsigned long long)stats.aux_bytes);
+    if (stats.budget_bytes) {
+        printf("Presupuesto de memoria: %llu bytes\n", (unsigned long long)stats.budget_bytes);
+    } else {
+        printf("Presupuesto de memoria: sin limite\n");
+    }
+    printf("Desalojadas por presupuesto: %llu\n", (unsigned long long)stats.budget_evicted);
+    printf("Liberadas por el shrinker: %llu\n", (unsigned long long)stats.shrinker_freed);
+    for (int p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        printf("Clase %s: %llu/%llu entradas, %llu desalojadas\n", prio_names[p],
+               (unsigned long long)stats.prio_entries[p], (unsigned long long)stats.prio_capacity[p],
+               (unsigned long long)stats.prio_evicted[p]);
+    }
+    printf("Escrituras descartadas por limite de tasa: %llu\n", (unsigned long long)stats.rate_dropped);
+    printf("Escrituras rechazadas por limite de tasa: %llu\n", (unsigned long long)stats.rate_rejected);
+    printf("Nodo NUMA del buffer: %lld\n", (long long)stats.numa_home_node);
+    printf("Escrituras locales/remotas: %llu/%llu\n", (unsigned long long)stats.local_writes,
+           (unsigned long long)stats.remote_writes);
+    printf("Lecturas locales/remotas: %llu/%llu\n", (unsigned long long)stats.local_reads,
+           (unsigned long long)stats.remote_reads);
+    printf("Claves indexadas: %llu\n", (unsigned long long)stats.keys);
+    printf("Escrituras descartadas por muestreo: %llu (se guarda 1 de cada %llu)\n", (unsigned long long)stats.sampled,
+           (unsigned long long)stats.sample_ratio);
+    printf("Entradas no publicadas por netlink: %llu\n", (unsigned long long)stats.netlink_dropped);
+}
+
+/*Muestra una entrada recibida por netlink en el formato de salida, si su clase está entre las que se leen*/
+void print_subscribed(const struct chardev_record *record, const char *message, void *arg){
+	if (!(prio_config.read_mask & CHARDEV_PRIO_MASK(record->prio))) {
+		return;
+	}
+	if (output_format == OUTPUT_JSON) {
+		print_json_record(record, message, arg);
+	} else {
+		print_text(message, record->len);
+	}
+	fflush(stdout);
+}
 
-    /*La funcion strtok() divide el string en "tokens" usando como delimitador \n, cada token es una entrada
-	*EL bucle itera mientras strok() siga encontrando líneas e incrementa el contador */
-    char *token = strtok(buffer, "\n");
-    while(token != NULL) { 
-        count++; 
+/*Función para recibir las entradas nuevas sin leer el dispositivo:
+*Se suscribe al grupo multicast de generic netlink del módulo (cargado con netlink=1) y muestra cada lote que llega
+*Si el programa se atrasa el kernel descarta lotes, se avisa y se sigue recibiendo
+*/
+void subscribe_device(void){
+	struct chardev_subscriber *sub = chardev_subscribe();
+
+	if (!sub) {
+		perror("Error: No se pudo suscribir a las entradas (cargar el modulo con netlink=1, requiere CAP_NET_ADMIN)");
+		return;
+	}
+	for (;;) {
+		if (chardev_receive(sub, print_subscribed, NULL) == -1) {
+			if (errno != ENOBUFS) {
+				perror("Error: No se logro recibir las entradas");
+				break;
+			}
+			fprintf(stderr, "Aviso: Se perdieron entradas por no leer a tiempo\n");
+		}
+	}
+	chardev_unsubscribe(sub);
+}
 
-        /*Continúa buscando en el buffer desde donde quedó la última vez, devolviendo el siguiente token.
-		*NULL indica que debe seguir procesando el mismo string.
-    	*Cuando no hay más tokens, devuelve NULL y el bucle termina.
-		*/ 
-		token = strtok(NULL, "\n");
+/*Función para mostrar las entradas nuevas a medida que se escriben:
+*spec: "N,T", el módulo avisa por un eventfd cada N entradas nuevas o a más tardar T microsegundos después de la primera sin avisar
+*Al despertar se lee desde la posición actual hasta el final, así un aviso entrega todas las entradas acumuladas
+*/
+void watch_device(const char *spec){
+	struct chardev_handle *dev = device();
+	unsigned int every = 0;
+	unsigned long long interval_us = 0;
+	uint64_t wakeups;
+	int efd;
+
+	if (sscanf(spec, "%u,%llu", &every, &interval_us) < 1) {
+		fprintf(stderr, "Error: Umbral invalido, se espera N o N,T (por ejemplo 100,5000)\n");
+		return;
+	}
+	if (!dev || apply_read_filter(dev) == -1 || apply_format(dev) == -1) {
+		return;
+	}
+	efd = eventfd(0, EFD_CLOEXEC);
+	if (efd == -1 || chardev_notify(dev, efd, every, interval_us) == -1 || chardev_seek(dev, 0, SEEK_END) == -1) {
+		perror("Error: No se pudo registrar el aviso de entradas");
+		if (efd != -1) {
+			close(efd);
+		}
+		return;
+	}
+	while (read(efd, &wakeups, sizeof(wakeups)) == sizeof(wakeups) || errno == EINTR) {
+		print_to_end(dev);
+		fflush(stdout);
+	}
+	chardev_notify(dev, -1, 0, 0);
+	close(efd);
+}
+
+/*Función para guardar las entradas en el archivo de persistencia del módulo:
+*Usa el ioctl CHARDEV_IOC_PERSIST, el módulo debe cargarse con persist_path y requiere permisos de administrador
+*/
+void save_device(void) {
+    struct chardev_handle *dev = device();
+
+    if (dev && chardev_persist(dev) == -1) {
+        perror("Error: No se pudo guardar el buffer");
     }
-    printf("Número de entradas: %d\n", count);
 }
 
 /*Función para limpiar todas entradas:
 *Envía el comando especial "CLEAR" que el driver interpreta para liberar todas las entradas del buffer circular.
  */
 void clean_device(void) {
-    int fd = open(DEVICE_PATH, O_WRONLY);
-    if (fd == -1) {
-        fprintf(stderr, "Error: No se pudo abrir el char device\n");
-        return;
-    }
-    if (write(fd, "CLEAR", 5) < 0) {
+    struct chardev_handle *dev = device();
+
+    if (dev && chardev_clear(dev) == -1) {
         fprintf(stderr, "Error: No se pudo enviar comando de limpieza\n");
     }
-    close(fd);
 }
 
 int main(int argc, char *argv[]){
+	if (!isatty(STDOUT_FILENO)) {
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER);
+	}
 	vrgcli("Programa de userspace v1.0"){
 
 		//Muestra ayuda
@@ -183,6 +1518,29 @@ int main(int argc, char *argv[]){
 			vrgusage();
 		}
 
+		//Filtros para las lecturas siguientes
+		vrgarg("--prefix text\tLeer solo las entradas que empiezan con text"){
+			set_read_filter(CHARDEV_FILTER_PREFIX, vrgarg);
+		}
+
+		vrgarg("--grep text\tLeer solo las entradas que contienen text"){
+			set_read_filter(CHARDEV_FILTER_SUBSTR, vrgarg);
+		}
+
+		//Prioridad de las escrituras y clases de las lecturas siguientes
+		vrgarg("--prio level\tEscribir los mensajes siguientes con prioridad level (low, normal, critical)"){
+			set_write_prio(vrgarg);
+		}
+
+		vrgarg("--classes list\tLeer solo las clases de la lista (por ejemplo critical,normal)"){
+			set_read_classes(vrgarg);
+		}
+
+		//Formato de salida de las lecturas siguientes
+		vrgarg("--format fmt\tFormato de salida de las lecturas: text o json"){
+			set_output_format(vrgarg);
+		}
+
 		//Mestra el último mensaje
 		vrgarg("-l\tMostrar ultimo mensaje"){
 			read_chardev(1);
@@ -194,17 +1552,85 @@ int main(int argc, char *argv[]){
 			clean_device(); 
 		}
 
+		//Guardar las entradas en el archivo de persistencia
+		vrgarg("--save\tGuardar las entradas en el archivo persist_path del modulo"){
+			save_device();
+		}
+
 		//Leer el device
 		vrgarg("-r\tLeer el char device"){
 			printf("Leyendo dispositivo:\n");
 			read_chardev(0);
 		}
 
+		//Leer las entradas de los últimos segundos
+		vrgarg("--since seconds\tLeer las entradas de los ultimos segundos"){
+			read_since(atof(vrgarg));
+		}
+
+		//Leer las últimas N entradas
+		vrgarg("-n N\tLeer las ultimas N entradas"){
+			read_tail(atol(vrgarg));
+		}
+
+		//Leer el device con io_uring
+		vrgarg("--uring\tLeer el char device con io_uring (lotes de lecturas)"){
+			read_uring();
+		}
+
+		//Medir las lecturas con io_uring contra pread
+		vrgarg("--uring-bench N\tMedir N lecturas con io_uring y con pread"){
+			bench_uring(atol(vrgarg));
+		}
+
+		//Mostrar las entradas nuevas con avisos de eventfd
+		vrgarg("--watch N,T\tMostrar las entradas nuevas, despertando cada N entradas o a mas tardar T microsegundos"){
+			watch_device(vrgarg);
+		}
+
+		//Recibir las entradas nuevas por netlink
+		vrgarg("--subscribe\tMostrar las entradas nuevas a medida que se escriben (modulo cargado con netlink=1)"){
+			subscribe_device();
+		}
+
+		//Pruebas y mediciones del device
+		vrgarg("--force\tPermitir que --bench y --profile borren las entradas actuales del dispositivo"){
+			bench_force = 1;
+		}
+
+		vrgarg("--bench N\tProbar y medir escrituras y lecturas con N operaciones (escribe entradas de prueba)"){
+			bench_device(atol(vrgarg));
+		}
+
+		vrgarg("--profile N\tMedir ciclos, instrucciones, fallos de cache y cambios de contexto de N operaciones de cada tipo (escribe entradas de prueba)"){
+			profile_device(atol(vrgarg));
+		}
+
+		//Leer un rango de entradas
+		vrgarg("--range i:j\tLeer las entradas de la i a la j (0 es la mas antigua)"){
+			read_range(vrgarg);
+		}
+
+		//Leer el valor más reciente de una clave
+		vrgarg("--get key\tLeer la entrada mas reciente de key (mensajes key=valor, modulo con keyed=1)"){
+			read_key(vrgarg);
+		}
+
 		//Contar las entradas del device
 		vrgarg("--count\tContar las entradas del device"){
 			count_entries(); 
 		}
 		
+		//Mostrar las estadísticas del device
+		vrgarg("--stats\tMostrar las estadisticas del device"){
+			print_stats();
+		}
+		
+		//Escribir las líneas de la entrada estándar por lotes
+		vrgarg("--stdin\tEscribir cada linea de la entrada estandar como una entrada (por lotes)"){
+			write_stdin();
+		}
+
 		//Escribir una entrada en el char device (Argumento opcional)
 		vrgarg("[message]\tThe string to write on the char device"){
 			printf("Escribiendo: %s\n", vrgarg);
@@ -216,5 +1642,8 @@ int main(int argc, char *argv[]){
 			vrgusage("Unexpected argument: %s\n", vrgarg);
 		}
 	}
+
+	//Cierra el dispositivo, los mensajes acumulados se envían antes
+	chardev_close(shared_dev);
 	return 0;
 }
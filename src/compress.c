@@ -0,0 +1,144 @@
+//Archivo para la compresión LZ4 opcional de las entradas del char device
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/lz4.h> //Para LZ4_compress_default() y LZ4_decompress_safe()
+#include "compress.h"
+
+/*Parámetro compress: activa la compresión de las entradas nuevas
+*Solo se lee al cargar el módulo porque los buffers por CPU se reservan en ese momento
+*/
+static bool compress;
+module_param(compress, bool, 0444);
+MODULE_PARM_DESC(compress, "Comprimir las entradas con LZ4 (por defecto desactivado)");
+
+/*Contexto de compresión por CPU:
+*lock: mutex para el contexto, el escritor puede cambiar de CPU mientras lo usa
+*wrkmem: memoria de trabajo de LZ4_compress_default
+*out: resultado de la compresión, el llamador lo copia a la entrada antes de liberar el contexto
+*/
+struct compress_ctx {
+    struct mutex lock;
+    void *wrkmem;
+    char *out;
+};
+
+/*Buffers por CPU:
+*ctxs: contextos de compresión de los escritores
+*decompress_buf: destino de la descompresión en las lecturas, se usa con el spinlock del buffer tomado o con la expropiación deshabilitada
+*/
+static struct compress_ctx __percpu *ctxs;
+static DEFINE_PER_CPU(char *, decompress_buf);
+
+//Libera los buffers por CPU que se hayan reservado
+void compress_exit(void) {
+    int cpu;
+
+    if (!ctxs) {
+        return;
+    }
+    for_each_possible_cpu(cpu) {
+        struct compress_ctx *ctx = per_cpu_ptr(ctxs, cpu);
+
+        vfree(ctx->wrkmem);
+        vfree(ctx->out);
+        vfree(per_cpu(decompress_buf, cpu));
+        per_cpu(decompress_buf, cpu) = NULL;
+    }
+    free_percpu(ctxs);
+    ctxs = NULL;
+}
+
+//Reserva un contexto y un buffer de descompresión por CPU
+int compress_init(void) {
+    int cpu;
+
+    if (!compress) {
+        return 0;
+    }
+    ctxs = alloc_percpu(struct compress_ctx);
+    if (!ctxs) {
+        return -ENOMEM;
+    }
+    for_each_possible_cpu(cpu) {
+        struct compress_ctx *ctx = per_cpu_ptr(ctxs, cpu);
+
+        mutex_init(&ctx->lock);
+        ctx->wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+        ctx->out = vmalloc(COMPRESS_MAX_INPUT);
+        per_cpu(decompress_buf, cpu) = vmalloc(COMPRESS_MAX_INPUT);
+        if (!ctx->wrkmem || !ctx->out || !per_cpu(decompress_buf, cpu)) {
+            compress_exit();
+            return -ENOMEM;
+        }
+    }
+    printk(KERN_INFO "Modulo: Compresion LZ4 activada\n");
+    return 0;
+}
+
+bool compress_enabled(void) {
+    return ctxs != NULL;
+}
+
+//Bytes reservados para los buffers de compresión de todos los CPU
+size_t compress_memory(void) {
+    if (!ctxs) {
+        return 0;
+    }
+    return num_possible_cpus() * (sizeof(struct compress_ctx) + LZ4_MEM_COMPRESS + 2 * COMPRESS_MAX_INPUT);
+}
+
+/*Comprime src con LZ4:
+*Solo se comprimen entradas entre COMPRESS_MIN_INPUT y COMPRESS_MAX_INPUT bytes
+*El límite de salida es len - 1, si LZ4 no logra reducir el tamaño retorna 0 y la entrada se guarda sin comprimir
+*Si retorna un contexto, *dst apunta a su buffer de salida y sigue bloqueado hasta compress_put()
+*/
+struct compress_ctx *compress_get(const char *src, size_t len, const char **dst, size_t *dst_len, bool nowait) {
+    struct compress_ctx *ctx;
+    int out;
+
+    if (!ctxs || len < COMPRESS_MIN_INPUT || len > COMPRESS_MAX_INPUT) {
+        return NULL;
+    }
+
+    /*Con nowait no se espera al contexto si otro escritor lo está usando, la entrada se guarda sin comprimir*/
+    ctx = raw_cpu_ptr(ctxs);
+    if (nowait) {
+        if (!mutex_trylock(&ctx->lock)) {
+            return NULL;
+        }
+    } else {
+        mutex_lock(&ctx->lock);
+    }
+    out = LZ4_compress_default(src, ctx->out, len, len - 1, ctx->wrkmem);
+    if (out <= 0) {
+        mutex_unlock(&ctx->lock);
+        return NULL;
+    }
+    *dst = ctx->out;
+    *dst_len = out;
+    return ctx;
+}
+
+void compress_put(struct compress_ctx *ctx) {
+    mutex_unlock(&ctx->lock);
+}
+
+/*Descomprime src (src_len bytes) en el buffer del CPU actual:
+*len es el tamaño original, retorna NULL si los datos están corruptos
+*El resultado es válido hasta la siguiente llamada en el mismo CPU
+*/
+const char *decompress_get(const char *src, size_t src_len, size_t len) {
+    char *buf = this_cpu_read(decompress_buf);
+
+    if (!buf || len > COMPRESS_MAX_INPUT) {
+        return NULL;
+    }
+    if (LZ4_decompress_safe(src, buf, src_len, len) != (int)len) {
+        return NULL;
+    }
+    return buf;
+}
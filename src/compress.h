@@ -0,0 +1,33 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+/*COMPRESS_MAX_INPUT: tamaño máximo de una entrada que se comprime, las más grandes se guardan sin comprimir
+*COMPRESS_MIN_INPUT: tamaño mínimo de una entrada que se comprime, en entradas cortas LZ4 no reduce el tamaño
+*/
+#define COMPRESS_MAX_INPUT (32 * 1024)
+#define COMPRESS_MIN_INPUT 32
+
+struct compress_ctx;
+
+//Funcion para reservar los buffers de compresión por CPU si el parámetro compress está activo
+int compress_init(void);
+
+//Funcion para liberar los buffers de compresión
+void compress_exit(void);
+
+//Funcion para saber si las entradas nuevas se deben comprimir
+bool compress_enabled(void);
+
+//Funcion para obtener los bytes reservados para los buffers de compresión
+size_t compress_memory(void);
+
+//Funcion para comprimir src, retorna el contexto bloqueado con el resultado en *dst o NULL si no conviene comprimir (o si nowait y está ocupado)
+struct compress_ctx *compress_get(const char *src, size_t len, const char **dst, size_t *dst_len, bool nowait);
+
+//Funcion para liberar el contexto retornado por compress_get
+void compress_put(struct compress_ctx *ctx);
+
+//Funcion para descomprimir en el buffer del CPU actual, debe llamarse sin poder cambiar de CPU (spinlock tomado)
+const char *decompress_get(const char *src, size_t src_len, size_t len);
+
+#endif
@@ -0,0 +1,58 @@
+//Archivo para los filtros de lectura por descriptor de archivo del char device
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/string.h> //Para memchr() y memcmp()
+#include "filter.h"
+
+//Valida el tipo y los límites del filtro antes de instalarlo en el descriptor
+int filter_validate(const struct chardev_filter *filter) {
+    switch (filter->type) {
+    case CHARDEV_FILTER_NONE:
+    case CHARDEV_FILTER_TAG:
+        return 0;
+    case CHARDEV_FILTER_PREFIX:
+    case CHARDEV_FILTER_SUBSTR:
+        if (filter->len == 0 || filter->len > CHARDEV_FILTER_MAX_PATTERN) {
+            return -EINVAL;
+        }
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+/*Búsqueda de una subcadena:
+*memchr localiza candidatos por el primer byte del patrón (está optimizado por arquitectura)
+*y memcmp solo se ejecuta en esas posiciones
+*/
+static bool contains(const char *data, size_t len, const char *pattern, size_t plen) {
+    const char *pos = data;
+    const char *end = data + len;
+
+    while ((size_t)(end - pos) >= plen) {
+        pos = memchr(pos, pattern[0], end - pos - plen + 1);
+        if (!pos) {
+            return false;
+        }
+        if (memcmp(pos + 1, pattern + 1, plen - 1) == 0) {
+            return true;
+        }
+        pos++;
+    }
+    return false;
+}
+
+//Verifica si la entrada (data, len) cumple con el filtro
+bool filter_match(const struct chardev_filter *filter, const char *data, size_t len) {
+    switch (filter->type) {
+    case CHARDEV_FILTER_PREFIX:
+        return len >= filter->len && memcmp(data, filter->pattern, filter->len) == 0;
+    case CHARDEV_FILTER_SUBSTR:
+        return contains(data, len, filter->pattern, filter->len);
+    case CHARDEV_FILTER_TAG:
+        return filter->tag_offset < len && (u8)data[filter->tag_offset] == filter->tag;
+    default:
+        return true;
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef FILTER_H
+#define FILTER_H
+#include "chardev_ioctl.h"
+
+//Funcion para validar un filtro recibido desde el espacio usuario
+int filter_validate(const struct chardev_filter *filter);
+
+//Funcion para verificar si una entrada cumple con el filtro
+bool filter_match(const struct chardev_filter *filter, const char *data, size_t len);
+
+#endif
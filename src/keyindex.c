@@ -0,0 +1,310 @@
+//Archivo para el índice de entradas por clave: de cada clave se guarda la entrada más reciente de cada clase de prioridad
+
+#include <linux/moduleparam.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+#include <linux/xxhash.h>
+#include <linux/err.h>
+#include <linux/sched.h> //Para cond_resched() al liberar una tabla grande
+#include "chardev_ioctl.h"
+#include "keyindex.h"
+
+/*Parámetro keyed: los mensajes "clave=valor" se indexan por su clave (los bytes antes de CHARDEV_KEY_DELIM),
+*así CHARDEV_IOC_KEY_LOOKUP entrega el valor más reciente de una clave sin recorrer el buffer
+*/
+static bool keyed;
+module_param(keyed, bool, 0444);
+MODULE_PARM_DESC(keyed, "Indexar los mensajes clave=valor por su clave");
+
+/*Clave del índice:
+*link: nodo de la cubeta, los lectores lo recorren con RCU
+*rcu: para liberar el nodo cuando ya no hay lectores que lo estén recorriendo
+*hash: xxh64 de la clave
+*seq: número de secuencia de la entrada más reciente de la clave en cada clase, KEY_NONE si no tiene
+*len, key: clave (no termina en nulo)
+*/
+struct key_node {
+    struct hlist_node link;
+    struct rcu_head rcu;
+    u64 hash;
+    u64 seq[CHARDEV_PRIO_COUNT];
+    u32 len;
+    char key[];
+};
+
+/*Tabla del índice:
+*retired: nodo de la lista de tablas reemplazadas por CLEAR
+*buckets: 2^bits cubetas, la cubeta de una clave son los bits altos de su hash
+*keys, bytes: claves en la tabla y memoria de sus nodos
+*/
+struct key_table {
+    struct llist_node retired;
+    struct hlist_head *buckets;
+    unsigned int bits;
+    u64 keys;
+    u64 bytes;
+};
+
+/*keys: tabla actual, los escritores la cambian con el spinlock del buffer tomado y los lectores la leen con RCU
+*retired: tablas reemplazadas por CLEAR pendientes de liberar
+*/
+static struct key_table __rcu *keys;
+static LLIST_HEAD(retired);
+
+static struct key_table *table_alloc(unsigned int bits) {
+    struct key_table *table = kzalloc(sizeof(*table), GFP_KERNEL);
+
+    if (!table) {
+        return NULL;
+    }
+    table->bits = bits;
+    table->buckets = kvcalloc(1UL << bits, sizeof(*table->buckets), GFP_KERNEL);
+    if (!table->buckets) {
+        kfree(table);
+        return NULL;
+    }
+    return table;
+}
+
+//Libera una tabla y sus nodos, ya no debe haber lectores recorriéndola
+static void table_free(struct key_table *table) {
+    unsigned long b;
+
+    for (b = 0; b < (1UL << table->bits); b++) {
+        struct key_node *node;
+        struct hlist_node *tmp;
+
+        hlist_for_each_entry_safe(node, tmp, &table->buckets[b], link) {
+            kfree(node);
+        }
+        cond_resched();
+    }
+    kvfree(table->buckets);
+    kfree(table);
+}
+
+static struct hlist_head *bucket(const struct key_table *table, u64 hash) {
+    return &table->buckets[hash >> (64 - table->bits)];
+}
+
+//Nodo de la clave en la tabla, NULL si no está. Se llama dentro de una sección de RCU o con el spinlock del buffer tomado
+static struct key_node *lookup(const struct key_table *table, const char *key, size_t len, u64 hash) {
+    struct key_node *node;
+
+    hlist_for_each_entry_rcu(node, bucket(table, hash), link) {
+        if (node->hash == hash && node->len == len && memcmp(node->key, key, len) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/*La tabla tiene una cubeta por entrada que cabe en los buffers, entre 2^KEY_HASH_MIN_BITS y 2^KEY_HASH_MAX_BITS*/
+int keyindex_init(unsigned int entries) {
+    struct key_table *table;
+
+    if (!keyed) {
+        return 0;
+    }
+    table = table_alloc(clamp_t(unsigned int, ilog2(roundup_pow_of_two(max(entries, 1U))),
+                                KEY_HASH_MIN_BITS, KEY_HASH_MAX_BITS));
+    if (!table) {
+        return -ENOMEM;
+    }
+    rcu_assign_pointer(keys, table);
+    return 0;
+}
+
+void keyindex_exit(void) {
+    struct key_table *table = rcu_dereference_protected(keys, 1);
+
+    RCU_INIT_POINTER(keys, NULL);
+    keyindex_release(keyindex_retired());
+    if (table) {
+        table_free(table);
+    }
+}
+
+bool keyindex_enabled(void) {
+    return rcu_access_pointer(keys) != NULL;
+}
+
+size_t keyindex_key(const char *data, size_t len) {
+    const char *delim = memchr(data, CHARDEV_KEY_DELIM, min_t(size_t, len, CHARDEV_KEY_MAX + 1));
+
+    return delim ? delim - data : 0;
+}
+
+u64 keyindex_hash(const char *key, size_t len) {
+    return xxh64(key, len, 0);
+}
+
+/*La búsqueda previa evita reservar un nodo en cada escritura de una clave conocida
+*Si la clave sale del índice entre esta búsqueda y keyindex_set, el nodo se reserva ahí sin dormir
+*/
+struct key_node *keyindex_prepare(const char *key, size_t len, u64 hash, gfp_t gfp) {
+    struct key_table *table;
+    struct key_node *node;
+    bool found;
+    int p;
+
+    rcu_read_lock();
+    table = rcu_dereference(keys);
+    found = table && lookup(table, key, len, hash);
+    rcu_read_unlock();
+    if (found) {
+        return NULL;
+    }
+
+    node = kmalloc(struct_size(node, key, len), gfp);
+    if (!node) {
+        return ERR_PTR(-ENOMEM);
+    }
+    node->hash = hash;
+    node->len = len;
+    memcpy(node->key, key, len);
+    for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+        node->seq[p] = KEY_NONE;
+    }
+    return node;
+}
+
+void keyindex_put(struct key_node *spare) {
+    kfree(spare);
+}
+
+/*Si la clave es nueva y no hay nodo preparado se reserva con GFP_ATOMIC, si falla la entrada queda sin indexar
+*(la clave no tenía otras entradas en el índice, así que no queda apuntando a un valor viejo)
+*/
+void keyindex_set(const char *key, size_t len, u64 hash, unsigned int prio, u64 seq, struct key_node **spare) {
+    struct key_table *table = rcu_dereference_protected(keys, 1);
+    struct key_node *node;
+
+    if (!table) {
+        return;
+    }
+    node = lookup(table, key, len, hash);
+    if (!node) {
+        node = *spare;
+        *spare = NULL;
+        if (!node) {
+            node = keyindex_prepare(key, len, hash, GFP_ATOMIC);
+        }
+        if (IS_ERR_OR_NULL(node)) {
+            return;
+        }
+        hlist_add_head_rcu(&node->link, bucket(table, hash));
+        table->keys++;
+        table->bytes += ksize(node);
+    }
+    WRITE_ONCE(node->seq[prio], seq);
+}
+
+/*Solo se compara el número de secuencia: si la clave tiene una entrada más reciente en la clase, la que sale no está en el índice
+*Cuando ninguna clase tiene entradas de la clave el nodo se quita y se libera después de un periodo de gracia
+*/
+void keyindex_drop(u64 hash, unsigned int prio, u64 seq) {
+    struct key_table *table = rcu_dereference_protected(keys, 1);
+    struct key_node *node;
+    int p;
+
+    if (!table) {
+        return;
+    }
+    hlist_for_each_entry(node, bucket(table, hash), link) {
+        if (node->hash != hash || node->seq[prio] != seq) {
+            continue;
+        }
+        WRITE_ONCE(node->seq[prio], KEY_NONE);
+        for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+            if (node->seq[p] != KEY_NONE) {
+                return;
+            }
+        }
+        hlist_del_rcu(&node->link);
+        table->keys--;
+        table->bytes -= ksize(node);
+        kfree_rcu(node, rcu);
+        return;
+    }
+}
+
+/*Sin tabla nueva (no hubo memoria) se vacía la actual quitando sus nodos uno por uno*/
+struct key_table *keyindex_swap(struct key_table *fresh) {
+    struct key_table *table = rcu_dereference_protected(keys, 1);
+    unsigned long b;
+
+    if (!table) {
+        return NULL;
+    }
+    if (fresh) {
+        rcu_assign_pointer(keys, fresh);
+        return table;
+    }
+    for (b = 0; b < (1UL << table->bits); b++) {
+        struct key_node *node;
+        struct hlist_node *tmp;
+
+        hlist_for_each_entry_safe(node, tmp, &table->buckets[b], link) {
+            hlist_del_rcu(&node->link);
+            kfree_rcu(node, rcu);
+        }
+    }
+    table->keys = 0;
+    table->bytes = 0;
+    return NULL;
+}
+
+u64 keyindex_find(const char *key, size_t len, unsigned int mask) {
+    struct key_table *table;
+    struct key_node *node;
+    u64 seq = KEY_NONE;
+    int p;
+
+    rcu_read_lock();
+    table = rcu_dereference(keys);
+    node = table ? lookup(table, key, len, keyindex_hash(key, len)) : NULL;
+    if (node) {
+        for (p = 0; p < CHARDEV_PRIO_COUNT; p++) {
+            u64 s = READ_ONCE(node->seq[p]);
+
+            if ((mask & CHARDEV_PRIO_MASK(p)) && s != KEY_NONE && (seq == KEY_NONE || s > seq)) {
+                seq = s;
+            }
+        }
+    }
+    rcu_read_unlock();
+    return seq;
+}
+
+struct key_table *keyindex_table(void) {
+    struct key_table *table = rcu_access_pointer(keys);
+
+    return table ? table_alloc(table->bits) : NULL;
+}
+
+void keyindex_retire(struct key_table *old) {
+    llist_add(&old->retired, &retired);
+}
+
+struct llist_node *keyindex_retired(void) {
+    return llist_del_all(&retired);
+}
+
+void keyindex_release(struct llist_node *list) {
+    struct key_table *table, *tmp;
+
+    llist_for_each_entry_safe(table, tmp, list, retired) {
+        table_free(table);
+    }
+}
+
+void keyindex_stats(u64 *count, u64 *bytes) {
+    struct key_table *table = rcu_dereference_protected(keys, 1);
+
+    *count = table ? table->keys : 0;
+    *bytes = table ? (1UL << table->bits) * sizeof(*table->buckets) + table->bytes : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef KEYINDEX_H
+#define KEYINDEX_H
+#include <linux/types.h>
+#include <linux/llist.h>
+#include <linux/limits.h>
+
+/*Índice de entradas por clave (parámetro keyed):
+*KEY_HASH_MIN_BITS, KEY_HASH_MAX_BITS: límites del número de cubetas de la tabla (potencia de 2 según la capacidad de los buffers)
+*KEY_NONE: número de secuencia de una clase sin entrada para la clave
+*/
+#define KEY_HASH_MIN_BITS 4
+#define KEY_HASH_MAX_BITS 20
+#define KEY_NONE U64_MAX
+
+struct key_node;
+struct key_table;
+
+//Funcion para reservar la tabla del índice con cubetas para entries entradas, no hace nada si el parámetro keyed está apagado
+int keyindex_init(unsigned int entries);
+
+//Funcion para liberar la tabla del índice, ya no debe haber lectores ni escritores
+void keyindex_exit(void);
+
+//Funcion para saber si el índice está activo (parámetro keyed y tabla reservada)
+bool keyindex_enabled(void);
+
+//Funcion para obtener la longitud de la clave de un mensaje (bytes antes de CHARDEV_KEY_DELIM), 0 si no tiene clave
+size_t keyindex_key(const char *data, size_t len);
+
+//Funcion para obtener el hash de una clave
+u64 keyindex_hash(const char *key, size_t len);
+
+/*Funcion para preparar la inserción de una clave antes de tomar el spinlock del buffer:
+*Si la clave no está en el índice reserva su nodo con gfp, retorna NULL si ya está o ERR_PTR(-ENOMEM) si no hay memoria
+*/
+struct key_node *keyindex_prepare(const char *key, size_t len, u64 hash, gfp_t gfp);
+
+/*Funciones que se llaman con el spinlock del buffer tomado:
+*keyindex_set: la entrada seq de la clase prio es la más reciente de la clave, usa *spare si la clave es nueva (y lo deja en NULL)
+*keyindex_drop: la entrada seq de la clase prio salió del buffer, si era la más reciente de la clave se quita del índice
+*keyindex_swap: reemplaza la tabla por fresh (vacía) y retorna la anterior, para CLEAR sin recorrer las claves
+*/
+void keyindex_set(const char *key, size_t len, u64 hash, unsigned int prio, u64 seq, struct key_node **spare);
+void keyindex_drop(u64 hash, unsigned int prio, u64 seq);
+struct key_table *keyindex_swap(struct key_table *fresh);
+
+//Funcion para liberar un nodo que keyindex_prepare reservó y no se usó
+void keyindex_put(struct key_node *spare);
+
+//Funcion para buscar la entrada más reciente de una clave entre las clases de mask (lectura con RCU), retorna su número de secuencia o KEY_NONE
+u64 keyindex_find(const char *key, size_t len, unsigned int mask);
+
+/*Tablas reemplazadas por CLEAR:
+*keyindex_table: reserva una tabla vacía del mismo tamaño que la actual, NULL si no hay memoria o el índice está apagado
+*keyindex_retire: deja la tabla anterior pendiente de liberar
+*keyindex_retired: saca las tablas pendientes, se llama antes de esperar el periodo de gracia de RCU
+*keyindex_release: libera las tablas que retornó keyindex_retired, después del periodo de gracia
+*/
+struct key_table *keyindex_table(void);
+void keyindex_retire(struct key_table *old);
+struct llist_node *keyindex_retired(void);
+void keyindex_release(struct llist_node *list);
+
+//Funcion para obtener las claves en el índice y la memoria que ocupa, se llama con el spinlock del buffer tomado
+void keyindex_stats(u64 *keys, u64 *bytes);
+
+#endif
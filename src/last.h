@@ -1,10 +0,0 @@
-#ifndef LAST_H
-#define LAST_H
-
-//Funcion para encontrar el ultimo mensaje ingresado al buffer
-const char* get_last_message(void);
-
-//Funcion para colocar el ultimo mensaje
-void set_last_message(const char *msg);
-
-#endif
\ No newline at end of file
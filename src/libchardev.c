@@ -0,0 +1,684 @@
+/*Biblioteca de espacio usuario para el char device
+*Headers:
+*<unistd.h>, <fcntl.h>: open(), close(), read(), write() y lseek()
+*<sys/ioctl.h>: comandos de control del dispositivo
+*<time.h>: reloj monotónico para el umbral de tiempo del escritor por lotes
+*<sys/socket.h>, <linux/netlink.h>, <linux/genetlink.h>: suscripción a las entradas nuevas por generic netlink
+*/
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+#include<unistd.h>
+#include<fcntl.h>
+#include<sys/ioctl.h>
+#include<time.h>
+#include<stdint.h>
+#include<sys/socket.h>
+#include<linux/netlink.h>
+#include<linux/genetlink.h>
+#include "libchardev.h"
+
+/*Buffer que crece según se necesita y se reutiliza entre operaciones:
+*data: memoria del buffer
+*used: bytes ocupados
+*cap: tamaño reservado
+*/
+struct chardev_buffer {
+	char *data;
+	size_t used;
+	size_t cap;
+};
+
+/*Estado del manejador:
+*fd: descriptor del dispositivo, se abre una sola vez
+*format: formato actual del descriptor (CHARDEV_FORMAT_*)
+*prio: prioridades instaladas en el descriptor, la clase de escritura se copia a los registros acumulados
+*pending: registros acumulados por el escritor por lotes, en el formato de escritura binaria
+*first_ns: momento en que se acumuló el primer mensaje pendiente
+*flush_bytes, flush_ms: umbrales de envío del escritor
+*dropped: mensajes acumulados que el módulo rechazó y se descartaron
+*in: buffer de las lecturas
+*/
+struct chardev_handle {
+	int fd;
+	unsigned int format;
+	struct chardev_prio prio;
+	struct chardev_buffer pending;
+	long long first_ns;
+	size_t flush_bytes;
+	unsigned int flush_ms;
+	unsigned long long dropped;
+	struct chardev_buffer in;
+};
+
+//Tiempo del reloj monotónico en nanosegundos
+static long long now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*Asegura que el buffer tenga espacio para size bytes más, duplicando su tamaño
+*Retorna -1 (ENOMEM) si no hay memoria o se pasaría de CHARDEV_BUFFER_LIMIT
+*/
+static int buffer_reserve(struct chardev_buffer *buf, size_t size){
+	size_t cap = buf->cap ? buf->cap : 4096;
+	char *data;
+
+	if (buf->used + size <= buf->cap) {
+		return 0;
+	}
+	while (cap < buf->used + size) {
+		cap *= 2;
+	}
+	if (cap > CHARDEV_BUFFER_LIMIT && buf->used + size <= CHARDEV_BUFFER_LIMIT) {
+		cap = CHARDEV_BUFFER_LIMIT;
+	}
+	if (cap > CHARDEV_BUFFER_LIMIT) {
+		errno = ENOMEM;
+		return -1;
+	}
+	data = realloc(buf->data, cap);
+	if (!data) {
+		errno = ENOMEM;
+		return -1;
+	}
+	buf->data = data;
+	buf->cap = cap;
+	return 0;
+}
+
+struct chardev_handle *chardev_open(const char *path, int flags){
+	struct chardev_handle *dev = calloc(1, sizeof(*dev));
+
+	if (!dev) {
+		return NULL;
+	}
+	dev->fd = open(path ? path : CHARDEV_PATH, flags);
+	if (dev->fd == -1) {
+		free(dev);
+		return NULL;
+	}
+	dev->format = CHARDEV_FORMAT_TEXT;
+	dev->prio.write_prio = CHARDEV_PRIO_NORMAL;
+	dev->prio.read_mask = CHARDEV_PRIO_ALL;
+	dev->flush_bytes = CHARDEV_FLUSH_BYTES;
+	dev->flush_ms = CHARDEV_FLUSH_MS;
+	return dev;
+}
+
+void chardev_close(struct chardev_handle *dev){
+	if (!dev) {
+		return;
+	}
+	chardev_flush(dev);
+	close(dev->fd);
+	free(dev->pending.data);
+	free(dev->in.data);
+	free(dev);
+}
+
+int chardev_fd(const struct chardev_handle *dev){
+	return dev->fd;
+}
+
+int chardev_set_filter(struct chardev_handle *dev, const struct chardev_filter *filter){
+	return ioctl(dev->fd, CHARDEV_IOC_SET_FILTER, filter);
+}
+
+int chardev_set_prio(struct chardev_handle *dev, const struct chardev_prio *prio){
+	if (ioctl(dev->fd, CHARDEV_IOC_SET_PRIO, prio) == -1) {
+		return -1;
+	}
+	dev->prio = *prio;
+	return 0;
+}
+
+int chardev_set_format(struct chardev_handle *dev, unsigned int format){
+	__u32 value = format;
+
+	if (dev->format == format) {
+		return 0;
+	}
+	if (ioctl(dev->fd, CHARDEV_IOC_SET_FORMAT, &value) == -1) {
+		return -1;
+	}
+	dev->format = format;
+	return 0;
+}
+
+/*Escritura de un mensaje o comando en formato de texto:
+*En formato binario la escritura se interpretaría como registros, el descriptor pasa a texto solo durante la escritura
+*/
+static int write_text(struct chardev_handle *dev, const char *msg, size_t len){
+	unsigned int format = dev->format;
+	int ret;
+
+	if (chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1) {
+		return -1;
+	}
+	ret = write(dev->fd, msg, len) == (ssize_t)len ? 0 : -1;
+	if (chardev_set_format(dev, format) == -1) {
+		return -1;
+	}
+	return ret;
+}
+
+int chardev_write(struct chardev_handle *dev, const char *msg, size_t len){
+	if (chardev_flush(dev) == -1) {
+		return -1;
+	}
+	return write_text(dev, msg, len);
+}
+
+void chardev_writer_limits(struct chardev_handle *dev, size_t flush_bytes, unsigned int flush_ms){
+	if (flush_bytes) {
+		dev->flush_bytes = flush_bytes;
+	}
+	if (flush_ms) {
+		dev->flush_ms = flush_ms;
+	}
+}
+
+/*Acumula el mensaje como un registro binario (encabezado, mensaje y relleno con ceros)
+*El registro siempre lleva su clase, sin prioridad explícita se usa la instalada con chardev_set_prio
+*Un mensaje se envía siempre completo: si el buffer ya tiene mensajes y el nuevo no cabe en flush_bytes, primero se envían los anteriores
+*/
+int chardev_append(struct chardev_handle *dev, const char *msg, size_t len, int prio){
+	struct chardev_record head = { .len = len, .prio = prio >= 0 ? (unsigned int)prio : dev->prio.write_prio };
+	size_t size = CHARDEV_RECORD_SIZE(len);
+
+	if (len == 0 || len > UINT32_MAX || prio >= CHARDEV_PRIO_COUNT) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (dev->pending.used > 0 && dev->pending.used + size > dev->flush_bytes && chardev_flush(dev) == -1) {
+		return -1;
+	}
+
+	if (buffer_reserve(&dev->pending, size) == -1) {
+		return -1;
+	}
+	if (dev->pending.used == 0) {
+		dev->first_ns = now_ns();
+	}
+	memcpy(dev->pending.data + dev->pending.used, &head, sizeof(head));
+	memcpy(dev->pending.data + dev->pending.used + sizeof(head), msg, len);
+	memset(dev->pending.data + dev->pending.used + sizeof(head) + len, 0, size - sizeof(head) - len);
+	dev->pending.used += size;
+
+	if (dev->pending.used >= dev->flush_bytes) {
+		return chardev_flush(dev);
+	}
+	return chardev_flush_due(dev);
+}
+
+/*Errores con los que el módulo rechaza un registro por sí mismo (longitud inválida, más grande que el presupuesto
+*de memoria), reintentarlo fallaría igual
+*/
+static int record_rejected(int err){
+	return err == EINVAL || err == ENOSPC || err == EFBIG;
+}
+
+/*Envía los registros acumulados:
+*El descriptor pasa al formato binario solo durante la escritura si estaba en formato de texto
+*El módulo guarda los registros en orden hasta el primero que falla. Si lo rechazó por sí mismo (record_rejected)
+*ese registro se descarta y se sigue con el resto, así un mensaje inválido no detiene al escritor.
+*Con otros errores (por ejemplo EAGAIN) los registros que faltan quedan acumulados para el siguiente intento
+*Retorna los mensajes descartados en este envío (0 si se guardaron todos) o -1
+*/
+int chardev_flush(struct chardev_handle *dev){
+	unsigned int format = dev->format;
+	size_t done = 0;
+	int ret = 0, lost = 0;
+
+	if (dev->pending.used == 0) {
+		return 0;
+	}
+	if (chardev_set_format(dev, CHARDEV_FORMAT_BINARY) == -1) {
+		return -1;
+	}
+	while (done < dev->pending.used) {
+		ssize_t n = write(dev->fd, dev->pending.data + done, dev->pending.used - done);
+
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n == -1 && record_rejected(errno)) {
+			struct chardev_record head;
+
+			memcpy(&head, dev->pending.data + done, sizeof(head));
+			done += CHARDEV_RECORD_SIZE(head.len);
+			dev->dropped++;
+			lost++;
+			continue;
+		}
+		if (n <= 0) {
+			ret = -1;
+			break;
+		}
+		done += n;
+	}
+	memmove(dev->pending.data, dev->pending.data + done, dev->pending.used - done);
+	dev->pending.used -= done;
+	if (dev->pending.used > 0) {
+		dev->first_ns = now_ns();
+	}
+	if (chardev_set_format(dev, format) == -1) {
+		return -1;
+	}
+	return ret == -1 ? -1 : lost;
+}
+
+int chardev_flush_due(struct chardev_handle *dev){
+	if (dev->pending.used == 0 || now_ns() - dev->first_ns < dev->flush_ms * 1000000LL) {
+		return 0;
+	}
+	return chardev_flush(dev);
+}
+
+size_t chardev_pending(const struct chardev_handle *dev){
+	return dev->pending.used;
+}
+
+unsigned long long chardev_dropped(const struct chardev_handle *dev){
+	return dev->dropped;
+}
+
+off_t chardev_seek(struct chardev_handle *dev, off_t offset, int whence){
+	return lseek(dev->fd, offset, whence);
+}
+
+/*Lee desde la posición actual hasta el final (read retorna 0) y deja los bytes en dev->in
+*Si fn no es NULL, después de cada lectura se decodifican los registros completos y se descartan,
+*solo queda en dev->in un registro incompleto que se completa con la siguiente lectura
+*/
+static int read_all(struct chardev_handle *dev, chardev_record_fn fn, void *arg){
+	ssize_t n;
+
+	dev->in.used = 0;
+	for (;;) {
+		if (dev->in.cap - dev->in.used < 4096 && buffer_reserve(&dev->in, dev->in.cap ? dev->in.cap : 4096) == -1) {
+			return -1;
+		}
+		n = read(dev->fd, dev->in.data + dev->in.used, dev->in.cap - dev->in.used);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n == -1) {
+			return -1;
+		}
+		if (n == 0) {
+			return 0;
+		}
+		dev->in.used += n;
+		if (fn) {
+			size_t consumed = chardev_decode_records(dev->in.data, dev->in.used, fn, arg);
+
+			memmove(dev->in.data, dev->in.data + consumed, dev->in.used - consumed);
+			dev->in.used -= consumed;
+		}
+	}
+}
+
+ssize_t chardev_read_text(struct chardev_handle *dev, const char **text){
+	if (chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1 || read_all(dev, NULL, NULL) == -1) {
+		return -1;
+	}
+	*text = dev->in.data;
+	return dev->in.used;
+}
+
+int chardev_stream_text(struct chardev_handle *dev, chardev_text_fn fn, void *arg){
+	ssize_t n;
+
+	dev->in.used = 0;
+	if (chardev_set_format(dev, CHARDEV_FORMAT_TEXT) == -1 || buffer_reserve(&dev->in, CHARDEV_STREAM_BYTES) == -1) {
+		return -1;
+	}
+	for (;;) {
+		n = read(dev->fd, dev->in.data, dev->in.cap);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n == -1) {
+			return -1;
+		}
+		if (n == 0) {
+			return 0;
+		}
+		fn(dev->in.data, n, arg);
+	}
+}
+
+int chardev_read_records(struct chardev_handle *dev, chardev_record_fn fn, void *arg){
+	if (chardev_set_format(dev, CHARDEV_FORMAT_BINARY) == -1) {
+		return -1;
+	}
+	return read_all(dev, fn, arg);
+}
+
+int chardev_last(struct chardev_handle *dev, chardev_record_fn fn, void *arg){
+	if (chardev_flush(dev) == -1 || write_text(dev, "LAST", 4) == -1) {
+		return -1;
+	}
+	return chardev_read_records(dev, fn, arg);
+}
+
+/*Consulta por rango con el buffer de lectura del manejador:
+*El módulo solo copia entradas completas. Si la primera no cabe falla con EMSGSIZE, y si no alcanzó a copiar todo el rango
+*marca la respuesta con CHARDEV_QUERY_TRUNCATED, en los dos casos se repite con el doble de espacio
+*(hasta CHARDEV_BUFFER_LIMIT, si ni así cabe el rango retorna -1 con EMSGSIZE en lugar de una respuesta incompleta)
+*/
+static int range_query(struct chardev_handle *dev, unsigned long cmd, void *query, __u64 *ubuf, __u64 *buf_len,
+                       __u64 *copied, __u32 *flags, const char **buf, size_t *len){
+	if (dev->in.cap == 0 && buffer_reserve(&dev->in, 64 * 1024) == -1) {
+		return -1;
+	}
+	for (;;) {
+		*ubuf = (unsigned long)dev->in.data;
+		*buf_len = dev->in.cap;
+		*flags = 0;
+		if (ioctl(dev->fd, cmd, query) == -1) {
+			if (errno != EMSGSIZE) {
+				return -1;
+			}
+		} else if (!(*flags & CHARDEV_QUERY_TRUNCATED)) {
+			break;
+		}
+		if (dev->in.cap >= CHARDEV_BUFFER_LIMIT) {
+			errno = EMSGSIZE;
+			return -1;
+		}
+		dev->in.used = 0;
+		if (buffer_reserve(&dev->in, dev->in.cap * 2 < CHARDEV_BUFFER_LIMIT ? dev->in.cap * 2 : CHARDEV_BUFFER_LIMIT) == -1) {
+			return -1;
+		}
+	}
+	dev->in.used = *copied;
+	*buf = dev->in.data;
+	*len = *copied;
+	return 0;
+}
+
+int chardev_time_range(struct chardev_handle *dev, __u64 from_ns, __u64 to_ns, const char **buf, size_t *len){
+	struct chardev_time_query query = { .from_ns = from_ns, .to_ns = to_ns };
+
+	return range_query(dev, CHARDEV_IOC_TIME_RANGE, &query, &query.buf, &query.buf_len, &query.copied, &query.flags, buf, len);
+}
+
+int chardev_index_range(struct chardev_handle *dev, __s64 first, __u64 count, const char **buf, size_t *len){
+	struct chardev_range_query query = { .first = first, .count = count };
+
+	return range_query(dev, CHARDEV_IOC_READ_RANGE, &query, &query.buf, &query.buf_len, &query.copied, &query.flags, buf, len);
+}
+
+/*La entrada de la clave se copia completa o no se copia, si no cabe (entries en 0) se duplica el buffer y se repite*/
+int chardev_key_lookup(struct chardev_handle *dev, const char *key, size_t key_len, const char **buf, size_t *len){
+	struct chardev_key_query query = { .key_len = key_len };
+
+	if (key_len == 0 || key_len > CHARDEV_KEY_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(query.key, key, key_len);
+	if (dev->in.cap == 0 && buffer_reserve(&dev->in, 64 * 1024) == -1) {
+		return -1;
+	}
+	for (;;) {
+		query.buf = (unsigned long)dev->in.data;
+		query.buf_len = dev->in.cap;
+		if (ioctl(dev->fd, CHARDEV_IOC_KEY_LOOKUP, &query) == -1) {
+			return -1;
+		}
+		if (query.entries > 0) {
+			break;
+		}
+		if (dev->in.cap >= CHARDEV_BUFFER_LIMIT) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		dev->in.used = 0;
+		if (buffer_reserve(&dev->in, dev->in.cap * 2) == -1) {
+			return -1;
+		}
+	}
+	dev->in.used = query.copied;
+	*buf = dev->in.data;
+	*len = query.copied;
+	return 0;
+}
+
+/*Decodificador del formato binario:
+*Cada registro mide CHARDEV_RECORD_SIZE(len), así el siguiente se encuentra sin buscar separadores
+*Un registro incompleto al final queda para la siguiente lectura
+*/
+size_t chardev_decode_records(const char *buf, size_t len, chardev_record_fn fn, void *arg){
+	struct chardev_record record;
+	size_t offset = 0;
+
+	while (len - offset >= sizeof(record)) {
+		memcpy(&record, buf + offset, sizeof(record));
+		if (len - offset < CHARDEV_RECORD_SIZE(record.len)) {
+			break;
+		}
+		fn(&record, buf + offset + sizeof(record), arg);
+		offset += CHARDEV_RECORD_SIZE(record.len);
+	}
+	return offset;
+}
+
+int chardev_stats(struct chardev_handle *dev, struct chardev_stats *stats){
+	return ioctl(dev->fd, CHARDEV_IOC_GET_STATS, stats);
+}
+
+int chardev_clear(struct chardev_handle *dev){
+	return write_text(dev, "CLEAR", 5);
+}
+
+int chardev_persist(struct chardev_handle *dev){
+	return ioctl(dev->fd, CHARDEV_IOC_PERSIST);
+}
+
+int chardev_notify(struct chardev_handle *dev, int efd, unsigned int every, unsigned long long interval_us){
+	struct chardev_notify notify = { .fd = efd, .every = every, .interval_us = interval_us };
+
+	return ioctl(dev->fd, CHARDEV_IOC_SET_NOTIFY, &notify);
+}
+
+/*Estado de una suscripción:
+*sock: socket NETLINK_GENERIC unido al grupo CHARDEV_NL_GROUP
+*family: id de la familia CHARDEV_NL_FAMILY, es el tipo de los mensajes de los lotes
+*in: buffer de los mensajes recibidos
+*/
+struct chardev_subscriber {
+	int sock;
+	__u16 family;
+	struct chardev_buffer in;
+};
+
+//Siguiente atributo de netlink en [*pos, end) y avanza *pos, NULL al terminar o si el atributo está truncado
+static const struct nlattr *next_attr(const char **pos, const char *end){
+	const struct nlattr *attr = (const struct nlattr *)*pos;
+
+	if (end - *pos < NLA_HDRLEN || attr->nla_len < NLA_HDRLEN || attr->nla_len > end - *pos) {
+		return NULL;
+	}
+	*pos += NLA_ALIGN(attr->nla_len);
+	return attr;
+}
+
+//Datos de un atributo de netlink
+static const char *attr_data(const struct nlattr *attr){
+	return (const char *)attr + NLA_HDRLEN;
+}
+
+/*Pregunta al controlador de generic netlink (CTRL_CMD_GETFAMILY) el id de la familia y de su grupo multicast
+*Retorna el id del grupo, o -1 con errno ENOENT si el módulo no registró la familia
+*/
+static int resolve_group(struct chardev_subscriber *sub){
+	struct {
+		struct nlmsghdr nlh;
+		struct genlmsghdr genl;
+		char attrs[NLA_HDRLEN + NLA_ALIGN(sizeof(CHARDEV_NL_FAMILY))];
+	} req = {0};
+	struct nlattr *name = (struct nlattr *)req.attrs;
+	const struct nlmsghdr *nlh;
+	const struct nlattr *attr, *group, *field;
+	const char *pos, *end, *gpos, *fpos;
+	char reply[8192];
+	int group_id = -1;
+	ssize_t n;
+
+	name->nla_type = CTRL_ATTR_FAMILY_NAME;
+	name->nla_len = NLA_HDRLEN + sizeof(CHARDEV_NL_FAMILY);
+	memcpy(req.attrs + NLA_HDRLEN, CHARDEV_NL_FAMILY, sizeof(CHARDEV_NL_FAMILY));
+	req.nlh.nlmsg_len = sizeof(req);
+	req.nlh.nlmsg_type = GENL_ID_CTRL;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST;
+	req.genl.cmd = CTRL_CMD_GETFAMILY;
+	req.genl.version = 1;
+	if (send(sub->sock, &req, sizeof(req), 0) == -1) {
+		return -1;
+	}
+	n = recv(sub->sock, reply, sizeof(reply), 0);
+	if (n == -1) {
+		return -1;
+	}
+	nlh = (const struct nlmsghdr *)reply;
+	if (!NLMSG_OK(nlh, n)) {
+		errno = EPROTO;
+		return -1;
+	}
+	if (nlh->nlmsg_type == NLMSG_ERROR) {
+		errno = -((const struct nlmsgerr *)NLMSG_DATA(nlh))->error;
+		return -1;
+	}
+
+	/*La respuesta trae el id de la familia y una lista de grupos anidados, cada uno con su nombre y su id*/
+	pos = (const char *)NLMSG_DATA(nlh) + GENL_HDRLEN;
+	end = (const char *)nlh + nlh->nlmsg_len;
+	while ((attr = next_attr(&pos, end))) {
+		if ((attr->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_FAMILY_ID) {
+			memcpy(&sub->family, attr_data(attr), sizeof(sub->family));
+		}
+		if ((attr->nla_type & NLA_TYPE_MASK) != CTRL_ATTR_MCAST_GROUPS) {
+			continue;
+		}
+		gpos = attr_data(attr);
+		while ((group = next_attr(&gpos, (const char *)attr + attr->nla_len))) {
+			const char *group_name = NULL;
+			__u32 id = 0;
+
+			fpos = attr_data(group);
+			while ((field = next_attr(&fpos, (const char *)group + group->nla_len))) {
+				if ((field->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_MCAST_GRP_NAME) {
+					group_name = attr_data(field);
+				} else if ((field->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_MCAST_GRP_ID) {
+					memcpy(&id, attr_data(field), sizeof(id));
+				}
+			}
+			if (group_name && strcmp(group_name, CHARDEV_NL_GROUP) == 0) {
+				group_id = id;
+			}
+		}
+	}
+	if (group_id == -1 || sub->family == 0) {
+		errno = ENOENT;
+	}
+	return sub->family ? group_id : -1;
+}
+
+struct chardev_subscriber *chardev_subscribe(void){
+	struct chardev_subscriber *sub = calloc(1, sizeof(*sub));
+	int group;
+
+	if (!sub) {
+		return NULL;
+	}
+	sub->sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (sub->sock == -1) {
+		free(sub);
+		return NULL;
+	}
+	group = resolve_group(sub);
+	if (group == -1 || setsockopt(sub->sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) == -1 ||
+	    buffer_reserve(&sub->in, 64 * 1024) == -1) {
+		int err = errno;
+
+		chardev_unsubscribe(sub);
+		errno = err;
+		return NULL;
+	}
+	return sub;
+}
+
+int chardev_subscriber_fd(const struct chardev_subscriber *sub){
+	return sub->sock;
+}
+
+/*Recibe un mensaje del grupo:
+*Con MSG_PEEK | MSG_TRUNC se conoce el tamaño del mensaje sin sacarlo del socket, así el buffer crece para lotes con entradas grandes
+*Cada atributo CHARDEV_NL_A_RECORD es un chardev_record seguido del mensaje, el encabezado se copia porque los atributos
+*solo están alineados a 4 bytes
+*/
+int chardev_receive(struct chardev_subscriber *sub, chardev_record_fn fn, void *arg){
+	const struct nlmsghdr *nlh;
+	const struct nlattr *attr;
+	const char *pos, *end;
+	int count = 0;
+	ssize_t n;
+
+	for (;;) {
+		n = recv(sub->sock, sub->in.data, sub->in.cap, MSG_PEEK | MSG_TRUNC);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n == -1) {
+			return -1;
+		}
+		if ((size_t)n <= sub->in.cap) {
+			break;
+		}
+		if (buffer_reserve(&sub->in, n) == -1) {
+			return -1;
+		}
+	}
+	n = recv(sub->sock, sub->in.data, sub->in.cap, 0);
+	if (n == -1) {
+		return -1;
+	}
+
+	for (nlh = (const struct nlmsghdr *)sub->in.data; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n)) {
+		if (nlh->nlmsg_type != sub->family) {
+			continue;
+		}
+		pos = (const char *)NLMSG_DATA(nlh) + GENL_HDRLEN;
+		end = (const char *)nlh + nlh->nlmsg_len;
+		while ((attr = next_attr(&pos, end))) {
+			struct chardev_record record;
+			size_t size = attr->nla_len - NLA_HDRLEN;
+
+			if ((attr->nla_type & NLA_TYPE_MASK) != CHARDEV_NL_A_RECORD || size < sizeof(record)) {
+				continue;
+			}
+			memcpy(&record, attr_data(attr), sizeof(record));
+			if (record.len > size - sizeof(record)) {
+				continue;
+			}
+			fn(&record, attr_data(attr) + sizeof(record), arg);
+			count++;
+		}
+	}
+	return count;
+}
+
+void chardev_unsubscribe(struct chardev_subscriber *sub){
+	if (!sub) {
+		return;
+	}
+	close(sub->sock);
+	free(sub->in.data);
+	free(sub);
+}
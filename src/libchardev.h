@@ -0,0 +1,124 @@
+/*Header LIBCHARDEV_H: biblioteca de espacio usuario para el char device
+*Un programa abre el dispositivo una sola vez (chardev_open) y usa el mismo descriptor para todas las operaciones
+*Las funciones retornan -1 y dejan el error en errno, no imprimen mensajes
+*
+*CHARDEV_PATH: ruta del dispositivo creado por el driver
+*CHARDEV_FLUSH_BYTES: bytes acumulados en el escritor por lotes que provocan un envío
+*CHARDEV_FLUSH_MS: milisegundos desde el primer mensaje acumulado que provocan un envío
+*CHARDEV_BUFFER_LIMIT: tamaño máximo de los buffers de lectura que crecen solos
+*CHARDEV_STREAM_BYTES: tamaño de cada bloque de las lecturas por bloques (chardev_stream_text)
+*/
+#ifndef LIBCHARDEV_H
+#define LIBCHARDEV_H
+#include <stddef.h>
+#include <sys/types.h>
+#include "chardev_ioctl.h"
+
+#define CHARDEV_PATH "/dev/chardev"
+#define CHARDEV_FLUSH_BYTES (64 * 1024)
+#define CHARDEV_FLUSH_MS 100
+#define CHARDEV_BUFFER_LIMIT (64 * 1024 * 1024)
+#define CHARDEV_STREAM_BYTES (1024 * 1024)
+
+//Manejador del dispositivo, su contenido es privado de la biblioteca
+struct chardev_handle;
+
+//Función que recibe cada registro leído, message no termina en nulo (mide record->len bytes)
+typedef void (*chardev_record_fn)(const struct chardev_record *record, const char *message, void *arg);
+
+//Función que recibe cada bloque de texto leído, el bloque es válido solo durante la llamada
+typedef void (*chardev_text_fn)(const char *text, size_t len, void *arg);
+
+/*Apertura y cierre:
+*chardev_open: abre path (CHARDEV_PATH si es NULL) con flags de open(), retorna NULL si falla
+*chardev_close: envía los mensajes acumulados y cierra el descriptor
+*chardev_fd: descriptor del dispositivo, para poll o io_uring
+*/
+struct chardev_handle *chardev_open(const char *path, int flags);
+void chardev_close(struct chardev_handle *dev);
+int chardev_fd(const struct chardev_handle *dev);
+
+/*Configuración del descriptor:
+*chardev_set_filter: filtro de las lecturas (CHARDEV_FILTER_NONE lo quita)
+*chardev_set_prio: clase de las escrituras y clases que se leen
+*chardev_set_format: formato de las lecturas (CHARDEV_FORMAT_TEXT o CHARDEV_FORMAT_BINARY), no hace nada si ya es el actual
+*/
+int chardev_set_filter(struct chardev_handle *dev, const struct chardev_filter *filter);
+int chardev_set_prio(struct chardev_handle *dev, const struct chardev_prio *prio);
+int chardev_set_format(struct chardev_handle *dev, unsigned int format);
+
+/*Escrituras:
+*chardev_write: guarda un mensaje como una entrada de inmediato (antes envía los acumulados para conservar el orden)
+*chardev_writer_limits: umbrales de envío del escritor por lotes, 0 deja el valor actual
+*chardev_append: acumula un mensaje con prioridad prio (-1 usa la del descriptor), envía el lote si pasa un umbral
+*chardev_flush: envía los mensajes acumulados en una sola escritura, cada mensaje queda como una entrada.
+*Un mensaje que el módulo rechaza (EINVAL, ENOSPC) se descarta y se sigue con los demás. chardev_append y chardev_flush
+*retornan cuántos mensajes se descartaron en ese envío (0 si ninguno) o -1
+*chardev_flush_due: envía los mensajes acumulados solo si ya pasó el umbral de tiempo, para llamarla desde un ciclo de eventos
+*chardev_pending: bytes acumulados sin enviar
+*chardev_dropped: mensajes descartados desde que se abrió el manejador
+*/
+int chardev_write(struct chardev_handle *dev, const char *msg, size_t len);
+void chardev_writer_limits(struct chardev_handle *dev, size_t flush_bytes, unsigned int flush_ms);
+int chardev_append(struct chardev_handle *dev, const char *msg, size_t len, int prio);
+int chardev_flush(struct chardev_handle *dev);
+int chardev_flush_due(struct chardev_handle *dev);
+size_t chardev_pending(const struct chardev_handle *dev);
+unsigned long long chardev_dropped(const struct chardev_handle *dev);
+
+/*Lecturas:
+*chardev_seek: mueve la posición de lectura (lseek), la posición es el número de secuencia de una entrada
+*chardev_read_text: lee en formato de texto desde la posición hasta el final, *text apunta al buffer del manejador
+*y es válido hasta la siguiente lectura. Retorna los bytes leídos
+*chardev_stream_text: lee en formato de texto desde la posición hasta el final en bloques de CHARDEV_STREAM_BYTES
+*y llama a fn con cada bloque, la memoria no depende del número de entradas
+*chardev_read_records: lee en formato binario desde la posición hasta el final y llama a fn con cada registro
+*chardev_last: lee la entrada más reciente que cumple con el filtro (comando LAST), requiere abrir con escritura
+*chardev_time_range: entradas con timestamp dentro de [from_ns, to_ns] (CHARDEV_IOC_TIME_RANGE)
+*chardev_index_range: count entradas desde first, un first negativo cuenta desde la más reciente (CHARDEV_IOC_READ_RANGE)
+*chardev_key_lookup: entrada más reciente de la clave key entre las clases que lee el descriptor (CHARDEV_IOC_KEY_LOOKUP),
+*el módulo se carga con keyed=1. Retorna -1 con errno ENOENT si la clave no tiene entradas
+*En las consultas por rango y por clave *buf apunta al buffer del manejador con *len bytes en el formato actual del descriptor
+*Las consultas por rango entregan el rango completo, si no cabe ni en CHARDEV_BUFFER_LIMIT retornan -1 con errno EMSGSIZE
+*/
+off_t chardev_seek(struct chardev_handle *dev, off_t offset, int whence);
+ssize_t chardev_read_text(struct chardev_handle *dev, const char **text);
+int chardev_stream_text(struct chardev_handle *dev, chardev_text_fn fn, void *arg);
+int chardev_read_records(struct chardev_handle *dev, chardev_record_fn fn, void *arg);
+int chardev_last(struct chardev_handle *dev, chardev_record_fn fn, void *arg);
+int chardev_time_range(struct chardev_handle *dev, __u64 from_ns, __u64 to_ns, const char **buf, size_t *len);
+int chardev_index_range(struct chardev_handle *dev, __s64 first, __u64 count, const char **buf, size_t *len);
+int chardev_key_lookup(struct chardev_handle *dev, const char *key, size_t key_len, const char **buf, size_t *len);
+
+//Recorre los registros completos de buf y llama a fn con cada uno, retorna los bytes consumidos
+size_t chardev_decode_records(const char *buf, size_t len, chardev_record_fn fn, void *arg);
+
+/*Comandos:
+*chardev_stats: estadísticas del dispositivo (CHARDEV_IOC_GET_STATS)
+*chardev_clear: borra todas las entradas (comando CLEAR)
+*chardev_persist: guarda las entradas en el archivo persist_path del módulo (CHARDEV_IOC_PERSIST)
+*chardev_notify: registra el eventfd efd, que se incrementa cada every entradas nuevas o a más tardar interval_us
+*microsegundos después de la primera sin avisar (CHARDEV_IOC_SET_NOTIFY), efd -1 quita el registro
+*/
+int chardev_stats(struct chardev_handle *dev, struct chardev_stats *stats);
+int chardev_clear(struct chardev_handle *dev);
+int chardev_persist(struct chardev_handle *dev);
+int chardev_notify(struct chardev_handle *dev, int efd, unsigned int every, unsigned long long interval_us);
+
+//Suscripción a las entradas nuevas, su contenido es privado de la biblioteca
+struct chardev_subscriber;
+
+/*Suscripción por generic netlink (el módulo se carga con netlink=1), no usa el dispositivo:
+*chardev_subscribe: se une al grupo multicast del módulo, retorna NULL si falla (ENOENT si el módulo no registró la familia,
+*EPERM sin CAP_NET_ADMIN)
+*chardev_subscriber_fd: socket de la suscripción, para poll
+*chardev_receive: espera un lote de entradas y llama a fn con cada una, retorna el número de entradas del lote.
+*Si el suscriptor se atrasa el kernel descarta lotes y retorna -1 con errno ENOBUFS, la suscripción sigue activa
+*chardev_unsubscribe: cierra la suscripción
+*/
+struct chardev_subscriber *chardev_subscribe(void);
+int chardev_subscriber_fd(const struct chardev_subscriber *sub);
+int chardev_receive(struct chardev_subscriber *sub, chardev_record_fn fn, void *arg);
+void chardev_unsubscribe(struct chardev_subscriber *sub);
+
+#endif
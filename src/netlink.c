@@ -0,0 +1,215 @@
+//Archivo para publicar las entradas nuevas en un grupo multicast de generic netlink
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/atomic.h>
+#include <linux/version.h>
+#include <net/genetlink.h>
+#include "chardev_ioctl.h"
+#include "netlink.h"
+
+/*Parámetro netlink: cada entrada nueva se publica en el grupo CHARDEV_NL_GROUP de la familia CHARDEV_NL_FAMILY
+*Las entradas se juntan en lotes y cada lote se copia una sola vez, el kernel lo entrega a todos los suscriptores
+*sin otra copia, así el costo no crece con el número de suscriptores
+*/
+static bool netlink;
+module_param(netlink, bool, 0644);
+MODULE_PARM_DESC(netlink, "Publicar las entradas nuevas por generic netlink multicast");
+
+/*Suscribirse al grupo requiere CAP_NET_ADMIN: el grupo entrega todas las entradas, igual que leer el dispositivo (0600)
+*GENL_MCAST_CAP_NET_ADMIN existe desde la versión 6.7 del kernel. En versiones anteriores cualquier proceso podría suscribirse,
+*así que la familia se registra pero las entradas no se publican aunque netlink=1 (NL_RESTRICTED)
+*/
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#define NL_RESTRICTED true
+static const struct genl_multicast_group chardev_groups[] = {
+    { .name = CHARDEV_NL_GROUP, .flags = GENL_MCAST_CAP_NET_ADMIN },
+};
+#else
+#define NL_RESTRICTED false
+static const struct genl_multicast_group chardev_groups[] = {
+    { .name = CHARDEV_NL_GROUP },
+};
+#endif
+
+static struct genl_family chardev_family = {
+    .name = CHARDEV_NL_FAMILY,
+    .version = CHARDEV_NL_VERSION,
+    .module = THIS_MODULE,
+    .mcgrps = chardev_groups,
+    .n_mcgrps = ARRAY_SIZE(chardev_groups),
+};
+
+/*Lote pendiente, protegido por batch_lock:
+*registered: la familia está registrada, netlink_publish no hace nada antes de netlink_init ni después de netlink_exit
+*batch: mensaje que se está llenando con atributos CHARDEV_NL_A_RECORD, NULL si no hay entradas pendientes
+*batch_hdr: encabezado de generic netlink del lote, genlmsg_end lo completa al enviarlo
+*batch_work: envía el lote NL_BATCH_MS después de su primera entrada aunque no esté lleno
+*dropped: entradas que no se publicaron porque no hubo memoria para su mensaje
+*/
+static DEFINE_SPINLOCK(batch_lock);
+static bool registered;
+static struct sk_buff *batch;
+static void *batch_hdr;
+static void flush_batch(struct work_struct *work);
+static DECLARE_DELAYED_WORK(batch_work, flush_batch);
+static atomic64_t dropped = ATOMIC64_INIT(0);
+
+//Envía el lote pendiente al grupo multicast, debe llamarse con batch_lock tomado
+static void send_batch(void) {
+    if (!batch) {
+        return;
+    }
+    genlmsg_end(batch, batch_hdr);
+    genlmsg_multicast(&chardev_family, batch, 0, 0, GFP_ATOMIC);
+    batch = NULL;
+}
+
+static void flush_batch(struct work_struct *work) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&batch_lock, flags);
+    send_batch();
+    spin_unlock_irqrestore(&batch_lock, flags);
+}
+
+int netlink_init(void) {
+    int ret = genl_register_family(&chardev_family);
+
+    if (ret) {
+        printk(KERN_ALERT "Modulo: No se pudo registrar la familia de netlink (%i)\n", ret);
+        return ret;
+    }
+    if (!NL_RESTRICTED && READ_ONCE(netlink)) {
+        printk(KERN_WARNING "Modulo: El kernel no puede restringir el grupo de netlink a CAP_NET_ADMIN (requiere 6.7), las entradas no se publicaran\n");
+    }
+    spin_lock_irq(&batch_lock);
+    registered = true;
+    spin_unlock_irq(&batch_lock);
+    return 0;
+}
+
+void netlink_exit(void) {
+    bool was_registered;
+
+    spin_lock_irq(&batch_lock);
+    was_registered = registered;
+    registered = false;
+    send_batch();
+    spin_unlock_irq(&batch_lock);
+
+    cancel_delayed_work_sync(&batch_work);
+    if (was_registered) {
+        genl_unregister_family(&chardev_family);
+    }
+}
+
+static bool publishing(void) {
+    return NL_RESTRICTED && READ_ONCE(netlink) && genl_has_listeners(&chardev_family, &init_net, 0);
+}
+
+//Copia el registro y el mensaje en un atributo CHARDEV_NL_A_RECORD del mensaje skb
+static void put_record(struct sk_buff *skb, const struct chardev_record *record, const char *msg) {
+    struct nlattr *attr = nla_reserve(skb, CHARDEV_NL_A_RECORD, sizeof(*record) + record->len);
+
+    if (attr) {
+        memcpy(nla_data(attr), record, sizeof(*record));
+        memcpy((char *)nla_data(attr) + sizeof(*record), msg, record->len);
+    }
+}
+
+/*Una entrada que no cabe en un lote va sola en su mensaje, que se reserva aquí con gfp (puede dormir)
+*El mensaje se reserva antes de publicar la entrada, netlink_publish solo lo llena y lo envía
+*/
+struct sk_buff *netlink_prepare(size_t len, gfp_t gfp) {
+    size_t size = nla_total_size(sizeof(struct chardev_record) + len);
+    struct sk_buff *skb;
+
+    if (size <= NL_BATCH_BYTES || !publishing()) {
+        return NULL;
+    }
+    skb = genlmsg_new(size, gfp);
+    if (!skb) {
+        atomic64_inc(&dropped);
+    }
+    return skb;
+}
+
+void netlink_put(struct sk_buff *own) {
+    if (own) {
+        nlmsg_free(own);
+    }
+}
+
+u64 netlink_dropped(void) {
+    return atomic64_read(&dropped);
+}
+
+//Envía una entrada grande en el mensaje que reservó netlink_prepare, sin tomar batch_lock
+static void publish_own(struct sk_buff *own, const struct chardev_record *record, const char *msg) {
+    void *hdr = genlmsg_put(own, 0, 0, &chardev_family, 0, CHARDEV_NL_CMD_ENTRIES);
+
+    if (!hdr || !READ_ONCE(registered)) {
+        nlmsg_free(own);
+        return;
+    }
+    put_record(own, record, msg);
+    genlmsg_end(own, hdr);
+    genlmsg_multicast(&chardev_family, own, 0, 0, GFP_ATOMIC);
+}
+
+/*Agrega una entrada al lote:
+*Si la entrada no cabe en el lote actual se envía primero. Una entrada más grande que NL_BATCH_BYTES se envía en own
+*(netlink_prepare), si no hay mensaje propio se cuenta como perdida
+*El primer registro de un lote programa batch_work para que ninguna entrada espere más de NL_BATCH_MS
+*Las reservas del lote usan GFP_ATOMIC porque se hacen con batch_lock tomado, si fallan la entrada se cuenta como perdida
+*/
+void netlink_publish(const struct chardev_record *record, const char *msg, struct sk_buff *own) {
+    size_t size = sizeof(*record) + record->len;
+    unsigned long flags;
+
+    if (own) {
+        publish_own(own, record, msg);
+        return;
+    }
+    if (!publishing()) {
+        return;
+    }
+    if (nla_total_size(size) > NL_BATCH_BYTES) {
+        atomic64_inc(&dropped);
+        return;
+    }
+
+    spin_lock_irqsave(&batch_lock, flags);
+    if (!registered) {
+        goto out;
+    }
+    if (batch && skb_tailroom(batch) < nla_total_size(size)) {
+        send_batch();
+    }
+    if (!batch) {
+        batch = genlmsg_new(NL_BATCH_BYTES, GFP_ATOMIC);
+        if (!batch) {
+            atomic64_inc(&dropped);
+            goto out;
+        }
+        batch_hdr = genlmsg_put(batch, 0, 0, &chardev_family, 0, CHARDEV_NL_CMD_ENTRIES);
+        if (!batch_hdr) {
+            nlmsg_free(batch);
+            batch = NULL;
+            atomic64_inc(&dropped);
+            goto out;
+        }
+        schedule_delayed_work(&batch_work, msecs_to_jiffies(NL_BATCH_MS));
+    }
+    put_record(batch, record, msg);
+
+    //Un lote donde ya no cabe ni un registro vacío se envía de inmediato
+    if (skb_tailroom(batch) < nla_total_size(sizeof(*record))) {
+        send_batch();
+    }
+out:
+    spin_unlock_irqrestore(&batch_lock, flags);
+}
@@ -0,0 +1,37 @@
+#ifndef NETLINK_H
+#define NETLINK_H
+#include <linux/types.h>
+
+/*Lotes de entradas que se publican por generic netlink:
+*NL_BATCH_BYTES: tamaño de cada mensaje multicast, las entradas se juntan hasta llenarlo
+*NL_BATCH_MS: milisegundos que una entrada puede esperar en el lote antes de enviarse
+*/
+#define NL_BATCH_BYTES (16 * 1024)
+#define NL_BATCH_MS 10
+
+struct chardev_record;
+struct sk_buff;
+
+//Funcion para registrar la familia de generic netlink y su grupo multicast
+int netlink_init(void);
+
+//Funcion para enviar el lote pendiente y quitar la familia, se puede llamar aunque netlink_init no se haya llamado
+void netlink_exit(void);
+
+/*Funcion para reservar con gfp el mensaje propio de una entrada de len bytes que no cabe en un lote, antes de publicarla:
+*Retorna NULL si la entrada cabe en un lote, si nadie escucha el grupo o si no hubo memoria (la entrada se cuenta como perdida)
+*/
+struct sk_buff *netlink_prepare(size_t len, gfp_t gfp);
+
+//Funcion para liberar el mensaje de netlink_prepare si la entrada no se llegó a publicar
+void netlink_put(struct sk_buff *own);
+
+/*Funcion para publicar una entrada nueva, no hace nada si el parámetro netlink está apagado o nadie escucha el grupo:
+*own es el mensaje de netlink_prepare (o NULL) y se envía o se libera aquí. No duerme, se puede llamar dentro de una sección de RCU
+*/
+void netlink_publish(const struct chardev_record *record, const char *msg, struct sk_buff *own);
+
+//Funcion para obtener las entradas que no se publicaron por falta de memoria
+u64 netlink_dropped(void);
+
+#endif
@@ -0,0 +1,139 @@
+//Archivo para avisar de las entradas nuevas con eventfd, agrupando varias entradas en un solo aviso
+
+#include <linux/eventfd.h>
+#include <linux/hrtimer.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/version.h> //hrtimer_setup desde la versión 6.13 y eventfd_signal sin contador desde la 6.8
+#include <linux/err.h>
+#include <linux/atomic.h> //xchg del registro de un descriptor
+#include "chardev_ioctl.h"
+#include "notify.h"
+
+/*Registro de un eventfd:
+*node: nodo de notify_list, los escritores lo recorren con RCU sin tomar locks
+*ctx: contexto del eventfd que se incrementa en cada aviso
+*every, interval: umbrales de aviso en entradas y en ns (0 desactiva cada uno)
+*mask: clases de prioridad que se cuentan
+*pending: entradas nuevas desde el último aviso
+*timer: avisa interval ns después de la primera entrada pendiente aunque no se llegue a every. Es un temporizador soft
+*(HRTIMER_MODE_REL_SOFT), vence en un softirq y no en la interrupción de hardware donde eventfd_signal no se debe llamar
+*/
+struct notify_reg {
+    struct list_head node;
+    struct eventfd_ctx *ctx;
+    u32 every;
+    u64 interval;
+    unsigned int mask;
+    atomic_t pending;
+    struct hrtimer timer;
+};
+
+/*notify_list: registros activos, notify_lock solo protege los cambios a la lista (registrar y quitar)*/
+static LIST_HEAD(notify_list);
+static DEFINE_SPINLOCK(notify_lock);
+
+//Avisa al eventfd si hay entradas pendientes, se puede llamar desde el temporizador y desde varios escritores a la vez
+static void signal_reg(struct notify_reg *reg) {
+    if (atomic_xchg(&reg->pending, 0) == 0) {
+        return;
+    }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+    eventfd_signal(reg->ctx);
+#else
+    eventfd_signal(reg->ctx, 1);
+#endif
+}
+
+static enum hrtimer_restart notify_timer(struct hrtimer *timer) {
+    signal_reg(container_of(timer, struct notify_reg, timer));
+    return HRTIMER_NORESTART;
+}
+
+/*Quita un registro que ya no está en *reg:
+*Después de sacarlo de la lista se espera un periodo de gracia, así ningún escritor lo sigue usando ni vuelve a armar
+*el temporizador, y recién entonces se cancela el temporizador y se suelta el eventfd
+*/
+static void release_reg(struct notify_reg *old) {
+    if (!old) {
+        return;
+    }
+    spin_lock(&notify_lock);
+    list_del_rcu(&old->node);
+    spin_unlock(&notify_lock);
+
+    synchronize_rcu();
+    hrtimer_cancel(&old->timer);
+    eventfd_ctx_put(old->ctx);
+    kfree(old);
+}
+
+/*El registro del descriptor se cambia con xchg: dos ioctl simultáneos sobre el mismo descriptor se llevan cada uno
+*un registro anterior distinto (o NULL), así ninguno se libera dos veces ni queda sin liberar
+*/
+int notify_register(struct notify_reg **reg, int fd, u32 every, u64 interval_ns, unsigned int mask) {
+    struct notify_reg *new = NULL;
+
+    if (fd >= 0) {
+        struct eventfd_ctx *ctx = eventfd_ctx_fdget(fd);
+
+        if (IS_ERR(ctx)) {
+            return PTR_ERR(ctx);
+        }
+        new = kzalloc(sizeof(*new), GFP_KERNEL);
+        if (!new) {
+            eventfd_ctx_put(ctx);
+            return -ENOMEM;
+        }
+        new->ctx = ctx;
+        new->every = (every || interval_ns) ? every : 1;
+        new->interval = interval_ns;
+        new->mask = mask;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+        hrtimer_setup(&new->timer, notify_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+        hrtimer_init(&new->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+        new->timer.function = notify_timer;
+#endif
+    }
+
+    if (new) {
+        spin_lock(&notify_lock);
+        list_add_tail_rcu(&new->node, &notify_list);
+        spin_unlock(&notify_lock);
+    }
+    release_reg(xchg(reg, new));
+    return 0;
+}
+
+void notify_unregister(struct notify_reg **reg) {
+    release_reg(xchg(reg, NULL));
+}
+
+/*Cuenta una entrada nueva:
+*Al llegar a every entradas pendientes se avisa de inmediato, la primera entrada pendiente arma el temporizador de interval
+*Si el aviso por número llega antes, el temporizador vence sin entradas pendientes y no avisa otra vez
+*/
+void notify_entry(unsigned int prio) {
+    struct notify_reg *reg;
+
+    if (list_empty(&notify_list)) {
+        return;
+    }
+    rcu_read_lock();
+    list_for_each_entry_rcu(reg, &notify_list, node) {
+        int pending;
+
+        if (!(reg->mask & CHARDEV_PRIO_MASK(prio))) {
+            continue;
+        }
+        pending = atomic_inc_return(&reg->pending);
+        if (reg->every && pending >= reg->every) {
+            signal_reg(reg);
+        } else if (pending == 1 && reg->interval) {
+            hrtimer_start(&reg->timer, ns_to_ktime(reg->interval), HRTIMER_MODE_REL_SOFT);
+        }
+    }
+    rcu_read_unlock();
+}
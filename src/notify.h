@@ -0,0 +1,19 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+#include <linux/types.h>
+
+struct notify_reg;
+
+/*Funcion para registrar el eventfd fd de un descriptor (reemplaza el registro anterior en *reg):
+*every, interval_ns: umbrales de aviso (chardev_notify), mask: clases de prioridad que se cuentan
+*Con fd negativo solo quita el registro anterior. Retorna 0 o un error negativo
+*/
+int notify_register(struct notify_reg **reg, int fd, u32 every, u64 interval_ns, unsigned int mask);
+
+//Funcion para quitar el registro de un descriptor al cerrarlo
+void notify_unregister(struct notify_reg **reg);
+
+//Funcion para contar una entrada nueva de la clase prio en todos los registros, se llama después de publicarla
+void notify_entry(unsigned int prio);
+
+#endif
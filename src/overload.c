@@ -0,0 +1,180 @@
+//Archivo para muestrear las escrituras cuando los lectores no alcanzan a consumirlas
+
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include "overload.h"
+
+/*Parámetros del muestreo, se pueden cambiar en /sys/module/modulo/parameters:
+*overload: si los lectores quedan atrasados más que la capacidad de los buffers durante OVERLOAD_WINDOWS ventanas,
+*las escrituras se aceptan 1 de cada N, con N = escrituras / entradas leídas en la última ventana.
+*El avance de los lectores es el del más atrasado de los que leen todas las clases sin filtro y leyeron en las últimas
+*OVERLOAD_WINDOWS ventanas. Un lector rápido o uno que solo lee algunas clases no oculta el atraso de los demás.
+*Solo se activa si hay lectores activos, un buffer sin lectores sigue guardando todo
+*overload_max: valor máximo de N
+*/
+static bool overload;
+module_param(overload, bool, 0644);
+MODULE_PARM_DESC(overload, "Muestrear las escrituras cuando los lectores no alcanzan a consumirlas");
+
+static unsigned int overload_max = 1024;
+module_param(overload_max, uint, 0644);
+MODULE_PARM_DESC(overload_max, "Maximo de escrituras por cada una que se guarda en sobrecarga");
+
+/*Contadores por CPU, cada escritor solo toca los de su CPU:
+*ticket: escrituras vistas en sobrecarga, se guarda la que cae en múltiplo de ratio
+*sampled: escrituras descartadas por el muestreo
+*/
+struct overload_cpu {
+    u64 ticket;
+    u64 sampled;
+};
+static DEFINE_PER_CPU(struct overload_cpu, overload_cpus);
+
+/*Estado del muestreo:
+*readers: lectores que leen todas las clases sin filtro (overload_consumed), readers_lock protege la lista
+*ratio: se guarda 1 de cada ratio escrituras, 1 fuera de sobrecarga
+*capacity: capacidad total de los buffers
+*window_lock: solo un escritor evalúa cada ventana, los demás no esperan (spin_trylock)
+*window_end: momento en ns en que termina la ventana actual
+*seq_start, sampled_start, consumed_start: valores al empezar la ventana, para medir lo escrito y lo leído en ella
+*hot: ventanas seguidas con los lectores atrasados más que capacity
+*/
+static LIST_HEAD(readers);
+static DEFINE_SPINLOCK(readers_lock);
+static unsigned int ratio = 1;
+static u64 capacity;
+static DEFINE_SPINLOCK(window_lock);
+static struct {
+    u64 window_end;
+    u64 seq_start;
+    u64 sampled_start;
+    u64 consumed_start;
+    unsigned int hot;
+} window;
+
+static u64 sampled_total(void) {
+    u64 total = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        total += per_cpu_ptr(&overload_cpus, cpu)->sampled;
+    }
+    return total;
+}
+
+void overload_init(u64 entries) {
+    capacity = entries;
+}
+
+/*La posición se actualiza sin lock, solo entrar o salir de la lista toma readers_lock*/
+void overload_consumed(struct overload_reader *reader, u64 seq, bool unfiltered) {
+    WRITE_ONCE(reader->seq, seq);
+    WRITE_ONCE(reader->last_ns, ktime_get_ns());
+    if (READ_ONCE(reader->listed) == unfiltered) {
+        return;
+    }
+    spin_lock(&readers_lock);
+    if (unfiltered && !reader->listed) {
+        list_add_tail(&reader->node, &readers);
+    } else if (!unfiltered && reader->listed) {
+        list_del(&reader->node);
+    }
+    WRITE_ONCE(reader->listed, unfiltered);
+    spin_unlock(&readers_lock);
+}
+
+void overload_reader_exit(struct overload_reader *reader) {
+    spin_lock(&readers_lock);
+    if (reader->listed) {
+        list_del(&reader->node);
+        reader->listed = false;
+    }
+    spin_unlock(&readers_lock);
+}
+
+//Posición del lector activo más atrasado, U64_MAX si no hay lectores activos
+static u64 slowest_reader(u64 now) {
+    struct overload_reader *reader;
+    u64 slowest = U64_MAX;
+
+    spin_lock(&readers_lock);
+    list_for_each_entry(reader, &readers, node) {
+        if (now - READ_ONCE(reader->last_ns) <= OVERLOAD_WINDOWS * OVERLOAD_WINDOW_MS * NSEC_PER_MSEC) {
+            slowest = min(slowest, READ_ONCE(reader->seq));
+        }
+    }
+    spin_unlock(&readers_lock);
+    return slowest;
+}
+
+/*Evaluación de una ventana:
+*El atraso es la distancia entre la próxima entrada y la posición del lector activo más atrasado, si supera la capacidad
+*ese lector ya perdió entradas que se desalojaron sin leerse. Lo leído en la ventana es el avance de esa misma posición
+*Con el atraso sostenido la tasa pasa a escrituras / entradas leídas, así lo que se guarda es lo que los lectores consumen.
+*Cuando el atraso baja de la mitad de la capacidad la tasa se reduce a la mitad en cada ventana hasta volver a 1
+*/
+static void overload_window(u64 next_seq, u64 now) {
+    u64 read_seq = slowest_reader(now);
+    bool active = read_seq != U64_MAX;
+    u64 sampled = sampled_total();
+    u64 offered = (next_seq - window.seq_start) + (sampled - window.sampled_start);
+    u64 drained = active && read_seq > window.consumed_start ? read_seq - window.consumed_start : 0;
+    u64 lag = active && next_seq > read_seq ? next_seq - read_seq : 0;
+    unsigned int limit = max(READ_ONCE(overload_max), 1U);
+    unsigned int n = READ_ONCE(ratio);
+
+    if (active && lag > capacity) {
+        window.hot++;
+    } else {
+        window.hot = 0;
+    }
+    if (window.hot >= OVERLOAD_WINDOWS) {
+        n = drained ? min_t(u64, div64_u64(offered + drained - 1, drained), limit) : limit;
+    } else if (lag <= capacity / 2) {
+        n = max(n / 2, 1U);
+    }
+    WRITE_ONCE(ratio, clamp(n, 1U, limit));
+
+    window.window_end = now + OVERLOAD_WINDOW_MS * NSEC_PER_MSEC;
+    window.seq_start = next_seq;
+    window.sampled_start = sampled;
+    window.consumed_start = active ? read_seq : 0;
+}
+
+/*El costo de una escritura descartada es un contador por CPU, sin reservar memoria ni tomar el spinlock del buffer*/
+unsigned int overload_check(u64 next_seq) {
+    u64 now;
+    unsigned int n;
+
+    if (!READ_ONCE(overload)) {
+        if (READ_ONCE(ratio) != 1) {
+            WRITE_ONCE(ratio, 1);
+        }
+        return 1;
+    }
+    now = ktime_get_ns();
+    if (now >= READ_ONCE(window.window_end) && spin_trylock(&window_lock)) {
+        if (now >= window.window_end) {
+            overload_window(next_seq, now);
+        }
+        spin_unlock(&window_lock);
+    }
+
+    n = READ_ONCE(ratio);
+    if (n <= 1) {
+        return 1;
+    }
+    if (this_cpu_inc_return(overload_cpus.ticket) % n != 0) {
+        this_cpu_inc(overload_cpus.sampled);
+        return 0;
+    }
+    return n;
+}
+
+void overload_stats(u64 *sampled, u64 *current) {
+    *sampled = sampled_total();
+    *current = READ_ONCE(ratio);
+}
@@ -0,0 +1,45 @@
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+#include <linux/types.h>
+#include <linux/list.h>
+
+/*Muestreo de escrituras en sobrecarga (parámetro overload):
+*OVERLOAD_WINDOW_MS: cada cuántos milisegundos se compara el avance de los escritores con el de los lectores
+*OVERLOAD_WINDOWS: ventanas seguidas con los lectores atrasados más que la capacidad del buffer para entrar en sobrecarga
+*/
+#define OVERLOAD_WINDOW_MS 100
+#define OVERLOAD_WINDOWS 2
+
+/*Posición de un lector para el muestreo, va en el estado de cada descriptor:
+*node: nodo de la lista de lectores que se comparan al evaluar cada ventana
+*seq: siguiente entrada que va a leer
+*last_ns: momento de su última lectura, un lector que no leyó en las últimas OVERLOAD_WINDOWS ventanas no cuenta
+*listed: el lector está en la lista
+*/
+struct overload_reader {
+    struct list_head node;
+    u64 seq;
+    u64 last_ns;
+    bool listed;
+};
+
+//Funcion para indicar la capacidad total de los buffers, un lector atrasado más que eso ya perdió entradas
+void overload_init(u64 capacity);
+
+/*Funcion para registrar el avance de un lector, seq es la siguiente entrada que va a leer
+*unfiltered: el lector lee todas las clases sin filtro. Los demás no cuentan, su posición no dice cuánto consumen
+*/
+void overload_consumed(struct overload_reader *reader, u64 seq, bool unfiltered);
+
+//Funcion para quitar al lector de la lista al cerrar su descriptor
+void overload_reader_exit(struct overload_reader *reader);
+
+/*Funcion para decidir si se guarda una escritura, next_seq es el número de secuencia que recibiría:
+*Retorna 0 si la escritura se descarta por el muestreo, o el peso de la entrada (cuántas escrituras representa, 1 sin sobrecarga)
+*/
+unsigned int overload_check(u64 next_seq);
+
+//Funcion para obtener las escrituras descartadas por el muestreo y la tasa actual (se guarda 1 de cada ratio)
+void overload_stats(u64 *sampled, u64 *ratio);
+
+#endif
@@ -0,0 +1,162 @@
+//Archivo para guardar y cargar la imagen del buffer del char device en un archivo
+
+#include <linux/fs.h> //Para filp_open(), kernel_read() y kernel_write()
+#include <linux/mm.h> //Para kvmalloc() y kvfree()
+#include <linux/err.h>
+#include <linux/slab.h> //Para kasprintf() y kfree()
+#include <linux/namei.h> //Para kern_path() y lock_rename()
+#include <linux/mount.h> //Para mnt_want_write()
+#include <linux/version.h> //struct renamedata cambió en las versiones 6.3 y 6.17 del kernel
+#include "persist.h"
+
+/*Reemplaza target por tmp, los dos archivos existen y están en el mismo directorio:
+*Sus dentries se toman con kern_path y con el directorio bloqueado (lock_rename) se verifica que sigan en él antes de vfs_rename
+*/
+static int persist_rename(const char *tmp, const char *target) {
+    struct path from, to;
+    struct dentry *parent, *trap;
+    int ret;
+
+    ret = kern_path(tmp, 0, &from);
+    if (ret) {
+        return ret;
+    }
+    ret = kern_path(target, 0, &to);
+    if (ret) {
+        path_put(&from);
+        return ret;
+    }
+    if (from.mnt != to.mnt) {
+        ret = -EXDEV;
+        goto out;
+    }
+    ret = mnt_want_write(from.mnt);
+    if (ret) {
+        goto out;
+    }
+
+    parent = dget_parent(from.dentry);
+    trap = lock_rename(parent, parent);
+    if (IS_ERR(trap)) {
+        ret = PTR_ERR(trap);
+    } else {
+        if (from.dentry->d_parent != parent || to.dentry->d_parent != parent ||
+            d_unhashed(from.dentry) || d_unhashed(to.dentry)) {
+            ret = -ENOENT;
+        } else {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 17, 0)
+            struct renamedata rd = {
+                .mnt_idmap = &nop_mnt_idmap,
+                .old_parent = parent,
+                .old_dentry = from.dentry,
+                .new_parent = parent,
+                .new_dentry = to.dentry,
+            };
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+            struct renamedata rd = {
+                .old_mnt_idmap = &nop_mnt_idmap,
+                .old_dir = d_inode(parent),
+                .old_dentry = from.dentry,
+                .new_mnt_idmap = &nop_mnt_idmap,
+                .new_dir = d_inode(parent),
+                .new_dentry = to.dentry,
+            };
+#else
+            struct renamedata rd = {
+                .old_mnt_userns = &init_user_ns,
+                .old_dir = d_inode(parent),
+                .old_dentry = from.dentry,
+                .new_mnt_userns = &init_user_ns,
+                .new_dir = d_inode(parent),
+                .new_dentry = to.dentry,
+            };
+#endif
+            ret = vfs_rename(&rd);
+        }
+        unlock_rename(parent, parent);
+    }
+    dput(parent);
+    mnt_drop_write(from.mnt);
+out:
+    path_put(&to);
+    path_put(&from);
+    return ret;
+}
+
+/*Escribe la imagen en path:
+*La imagen se escribe completa en <path>.tmp (permisos 0600, un solo kernel_write) y vfs_fsync la lleva al disco,
+*después se renombra sobre path. Así una escritura que falla o se interrumpe deja intacta la imagen anterior
+*path se crea vacío si no existe para que el renombrado lo reemplace
+*/
+int persist_write(const char *path, const void *buf, size_t len) {
+    struct file *file;
+    loff_t pos = 0;
+    ssize_t written;
+    char *tmp;
+    int ret;
+
+    tmp = kasprintf(GFP_KERNEL, "%s.tmp", path);
+    if (!tmp) {
+        return -ENOMEM;
+    }
+    file = filp_open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0600);
+    if (IS_ERR(file)) {
+        ret = PTR_ERR(file);
+        goto out;
+    }
+    written = kernel_write(file, buf, len, &pos);
+    ret = vfs_fsync(file, 0);
+    filp_close(file, NULL);
+    if (written < 0 || written != len) {
+        ret = written < 0 ? written : -EIO;
+        goto out;
+    }
+    if (ret) {
+        goto out;
+    }
+
+    file = filp_open(path, O_WRONLY | O_CREAT | O_LARGEFILE, 0600);
+    if (IS_ERR(file)) {
+        ret = PTR_ERR(file);
+        goto out;
+    }
+    filp_close(file, NULL);
+    ret = persist_rename(tmp, path);
+out:
+    kfree(tmp);
+    return ret;
+}
+
+/*Lee el archivo path completo:
+*El tamaño se toma del inode y se reserva un solo buffer, así la imagen se carga con un solo kernel_read
+*El llamador libera el buffer con kvfree
+*/
+void *persist_read(const char *path, size_t *len) {
+    struct file *file;
+    loff_t size, pos = 0;
+    ssize_t bytes;
+    void *buf;
+
+    file = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+    if (IS_ERR(file)) {
+        return file;
+    }
+    size = i_size_read(file_inode(file));
+    if (size <= 0 || size > PERSIST_MAX_SIZE) {
+        filp_close(file, NULL);
+        return ERR_PTR(-EINVAL);
+    }
+    buf = kvmalloc(size, GFP_KERNEL);
+    if (!buf) {
+        filp_close(file, NULL);
+        return ERR_PTR(-ENOMEM);
+    }
+    bytes = kernel_read(file, buf, size, &pos);
+    filp_close(file, NULL);
+    if (bytes != size) {
+        kvfree(buf);
+        return ERR_PTR(bytes < 0 ? bytes : -EIO);
+    }
+    *len = size;
+    return buf;
+}
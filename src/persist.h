@@ -0,0 +1,54 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+#include <linux/kernel.h>
+
+/*Formato de la imagen del buffer que se guarda en el archivo de persist_path:
+*Un encabezado persist_header seguido de count registros en orden de número de secuencia
+*Cada registro es un persist_record seguido del mensaje original (sin comprimir) relleno con ceros hasta múltiplo de 8 bytes
+*PERSIST_MAGIC: "CHDVLOG1" en little endian
+*PERSIST_MAX_SIZE: tamaño máximo de la imagen, se escribe y se lee completa en una sola operación
+*/
+#define PERSIST_MAGIC 0x31474f4c56444843ULL
+#define PERSIST_VERSION 1
+#define PERSIST_MAX_SIZE (256 * 1024 * 1024)
+#define PERSIST_RECORD_SIZE(len) (sizeof(struct persist_record) + ALIGN((size_t)(len), 8))
+
+/*Encabezado de la imagen:
+*count: número de registros
+*next_seq: número de secuencia que recibirá la próxima entrada después de cargar la imagen
+*size: tamaño total de la imagen en bytes
+*/
+struct persist_header {
+    u64 magic;
+    u32 version;
+    u32 count;
+    u64 next_seq;
+    u64 size;
+};
+
+/*Registro de una entrada:
+*seq, timestamp, hash, repeat, prio, weight: los mismos campos de la entrada (weight 0 en imágenes anteriores equivale a repeat + 1)
+*len: longitud del mensaje que sigue al registro
+*flags: PERSIST_HASHED si hash es válido
+*/
+#define PERSIST_HASHED 0x1
+
+struct persist_record {
+    u64 seq;
+    u64 timestamp;
+    u64 hash;
+    u32 len;
+    u32 repeat;
+    u8 prio;
+    u8 flags;
+    u16 reserved;
+    u32 weight;
+};
+
+//Funcion para escribir la imagen completa en path con una sola escritura, en un archivo temporal que reemplaza a path
+int persist_write(const char *path, const void *buf, size_t len);
+
+//Funcion para leer el archivo path completo en un buffer (kvmalloc) con una sola lectura, retorna ERR_PTR si falla
+void *persist_read(const char *path, size_t *len);
+
+#endif
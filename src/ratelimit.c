@@ -0,0 +1,159 @@
+//Archivo para limitar la tasa de escritura de cada escritor con token buckets
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/sched.h> //Para current->tgid
+#include <linux/hash.h> //Para hash_64()
+#include <linux/ktime.h>
+#include "ratelimit.h"
+
+/*Parámetros del límite de tasa, se pueden cambiar en /sys/module/modulo/parameters:
+*rate_limit: escrituras por segundo que se permiten a cada escritor en cada CPU (0 desactiva el límite).
+*Las cubetas son por CPU para no compartir líneas de caché entre escritores, un escritor que migra entre k CPU
+*puede llegar a k veces la tasa (para un límite estricto se fija el escritor a un CPU)
+*rate_burst: escrituras seguidas que se permiten antes de aplicar la tasa (0 usa rate_limit)
+*rate_per_fd: la cubeta es por descriptor de archivo en lugar de por proceso (tgid)
+*rate_drop: las escrituras en exceso se descartan en silencio y se cuentan, en lugar de retornar -EAGAIN
+*/
+static unsigned int rate_limit;
+module_param(rate_limit, uint, 0644);
+MODULE_PARM_DESC(rate_limit, "Escrituras por segundo por escritor y por CPU (0 sin limite)");
+
+static unsigned int rate_burst;
+module_param(rate_burst, uint, 0644);
+MODULE_PARM_DESC(rate_burst, "Rafaga de escrituras permitida (0 usa rate_limit)");
+
+static bool rate_per_fd;
+module_param(rate_per_fd, bool, 0644);
+MODULE_PARM_DESC(rate_per_fd, "Limitar por descriptor de archivo en lugar de por proceso");
+
+static bool rate_drop;
+module_param(rate_drop, bool, 0644);
+MODULE_PARM_DESC(rate_drop, "Descartar las escrituras en exceso en lugar de retornar -EAGAIN");
+
+/*Cubeta de un escritor:
+*key: tgid o dirección del struct file del escritor dueño de la cubeta
+*last: momento en ns de la última escritura cobrada
+*credit: crédito acumulado en ns, cada escritura cuesta NSEC_PER_SEC / rate_limit y el máximo es la ráfaga completa
+*/
+struct rate_bucket {
+    u64 key;
+    u64 last;
+    u64 credit;
+};
+
+/*Estado por CPU: cada CPU solo toca sus propias cubetas con la preempción desactivada, sin locks compartidos
+*dropped, rejected: escrituras descartadas y rechazadas en este CPU
+*/
+struct rate_cpu {
+    struct rate_bucket buckets[RATE_SETS][RATE_WAYS];
+    u64 dropped;
+    u64 rejected;
+};
+
+static struct rate_cpu __percpu *rate_cpus;
+
+int ratelimit_init(void) {
+    rate_cpus = alloc_percpu(struct rate_cpu);
+    return rate_cpus ? 0 : -ENOMEM;
+}
+
+void ratelimit_exit(void) {
+    free_percpu(rate_cpus);
+    rate_cpus = NULL;
+}
+
+size_t ratelimit_memory(void) {
+    return rate_cpus ? num_possible_cpus() * sizeof(struct rate_cpu) : 0;
+}
+
+//Crédito de una cubeta recargado hasta now, sin pasar de cap. Un now anterior a la última escritura no recarga nada
+static u64 refill(const struct rate_bucket *bucket, u64 now, u64 cap) {
+    return min(bucket->credit + (now > bucket->last ? now - bucket->last : 0), cap);
+}
+
+/*Cubeta de key en su conjunto:
+*Si el escritor no tiene cubeta toma una vacía, que empieza con la ráfaga completa, o reemplaza la usada hace más tiempo.
+*Al reemplazar, el nuevo escritor hereda el crédito de la cubeta (recargado hasta now) en lugar de una ráfaga completa,
+*así varios escritores que se turnan en un conjunto lleno comparten la cubeta y no consiguen una ráfaga en cada escritura
+*/
+static struct rate_bucket *find_bucket(struct rate_bucket *set, u64 key, u64 now, u64 cap) {
+    struct rate_bucket *victim = &set[0];
+    int way;
+
+    for (way = 0; way < RATE_WAYS; way++) {
+        struct rate_bucket *bucket = &set[way];
+
+        if (bucket->last != 0 && bucket->key == key) {
+            bucket->credit = refill(bucket, now, cap);
+            return bucket;
+        }
+        if (bucket->last == 0) {
+            bucket->key = key;
+            bucket->credit = cap;
+            return bucket;
+        }
+        if (bucket->last < victim->last) {
+            victim = bucket;
+        }
+    }
+    victim->key = key;
+    victim->credit = refill(victim, now, cap);
+    return victim;
+}
+
+/*Cobra una escritura en la cubeta del escritor en el CPU actual:
+*El crédito se recarga con el tiempo transcurrido desde la última escritura, hasta la ráfaga completa
+*now se lee con el CPU ya fijado (get_cpu_ptr), así otro escritor del mismo CPU no puede guardar un last posterior entre la lectura
+*del reloj y el cobro
+*/
+int ratelimit_check(const struct file *filep) {
+    unsigned int rate = READ_ONCE(rate_limit);
+    unsigned int burst = READ_ONCE(rate_burst);
+    struct rate_cpu *cpu;
+    struct rate_bucket *bucket;
+    u64 key, now, cost, cap;
+    int ret = 0;
+
+    if (rate == 0 || !rate_cpus) {
+        return 0;
+    }
+    cost = max_t(u64, NSEC_PER_SEC / rate, 1);
+    cap = (u64)(burst ? burst : rate) * cost;
+    key = READ_ONCE(rate_per_fd) ? (u64)(unsigned long)filep : (u64)current->tgid;
+
+    cpu = get_cpu_ptr(rate_cpus);
+    now = ktime_get_ns();
+    bucket = find_bucket(cpu->buckets[hash_64(key, RATE_SETS_BITS)], key, now, cap);
+    bucket->last = now;
+
+    if (bucket->credit >= cost) {
+        bucket->credit -= cost;
+    } else if (READ_ONCE(rate_drop)) {
+        cpu->dropped++;
+        ret = RATE_DROPPED;
+    } else {
+        cpu->rejected++;
+        ret = -EAGAIN;
+    }
+    put_cpu_ptr(rate_cpus);
+    return ret;
+}
+
+//Suma los contadores de todos los CPU
+void ratelimit_stats(u64 *dropped, u64 *rejected) {
+    int cpu;
+
+    *dropped = 0;
+    *rejected = 0;
+    if (!rate_cpus) {
+        return;
+    }
+    for_each_possible_cpu(cpu) {
+        struct rate_cpu *state = per_cpu_ptr(rate_cpus, cpu);
+
+        *dropped += READ_ONCE(state->dropped);
+        *rejected += READ_ONCE(state->rejected);
+    }
+}
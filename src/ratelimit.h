@@ -0,0 +1,30 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/*RATE_SETS_BITS: cada CPU guarda 2^RATE_SETS_BITS conjuntos de cubetas, el escritor se asigna a un conjunto por hash
+*RATE_WAYS: cubetas de cada conjunto, hasta RATE_WAYS escritores que caen en el mismo conjunto tienen cada uno su cubeta
+*RATE_DROPPED: valor de ratelimit_check() cuando la escritura en exceso se descarta en silencio
+*/
+#define RATE_SETS_BITS 4
+#define RATE_SETS (1 << RATE_SETS_BITS)
+#define RATE_WAYS 4
+#define RATE_DROPPED 1
+
+struct file;
+
+//Funcion para reservar las cubetas por CPU
+int ratelimit_init(void);
+
+//Funcion para liberar las cubetas por CPU
+void ratelimit_exit(void);
+
+//Funcion para obtener los bytes reservados para las cubetas
+size_t ratelimit_memory(void);
+
+//Funcion para cobrar una escritura al escritor de filep, retorna 0 si se permite, RATE_DROPPED si se descarta o -EAGAIN si se rechaza
+int ratelimit_check(const struct file *filep);
+
+//Funcion para obtener las escrituras descartadas y rechazadas por el límite de tasa
+void ratelimit_stats(u64 *dropped, u64 *rejected);
+
+#endif